@@ -4,28 +4,74 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+LIBS += -lz
+
+# Hot-path profiler (see profiler.h)
+# DEFINES += MLP_PROFILE
+
+# qmake CONFIG+=zstd also reads .zst datasets, needs libzstd
+zstd {
+    DEFINES += MLP_WITH_ZSTD
+    LIBS += -lzstd
+}
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    checkpoint.cpp \
+    controller.cpp \
+    crossvalidation.cpp \
+    dataloader.cpp \
+    dataset.cpp \
+    decompressor.cpp \
     drawdialog.cpp \
+    ensemble.cpp \
     graphnetwork.cpp \
+    imagebatch.cpp \
+    jobrunner.cpp \
+    livepredictor.cpp \
     main.cpp \
     mainwindow.cpp \
     matrix.cpp \
     matrixnetwork.cpp \
-    network.cpp
+    metrics.cpp \
+    modelregistry.cpp \
+    network.cpp \
+    preprocess.cpp \
+    profiler.cpp \
+    server.cpp \
+    snapshot.cpp \
+    threadpool.cpp \
+    tracer.cpp
 
 HEADERS += \
+    checkpoint.h \
     controller.h \
+    crossvalidation.h \
+    dataloader.h \
+    dataset.h \
+    decompressor.h \
     drawdialog.h \
+    ensemble.h \
     graphnetwork.h \
+    imagebatch.h \
+    jobrunner.h \
+    livepredictor.h \
     mainwindow.h \
     matrix.h \
     matrixnetwork.h \
+    metrics.h \
+    modelregistry.h \
     network.h \
-    neuron.h
+    neuron.h \
+    preprocess.h \
+    profiler.h \
+    server.h \
+    snapshot.h \
+    threadpool.h \
+    tracer.h
 
 FORMS += \
     drawdialog.ui \
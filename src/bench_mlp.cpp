@@ -0,0 +1,337 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#include "dataloader.h"
+#include "dataset.h"
+#include "ensemble.h"
+#include "graphnetwork.h"
+#include "matrixnetwork.h"
+
+namespace s21 {
+
+const std::string kBenchDataSet = "./datasets/23.csv";
+const std::string kBenchWeights = "./weights/weights_2_784_86__.txt";
+const size_t kBenchEpochSize = 1000;
+
+std::string ReadBenchLine() {
+  std::ifstream fp(kBenchDataSet);
+  std::string line;
+  std::getline(fp, line);
+  return line;
+}
+
+//  kBenchEpochSize samples of every letter, built from the bench line with
+//  a few pixels shifted per sample
+const SampleBatch& GetBenchDataSet() {
+  static SampleBatch data = [] {
+    SampleBatch batch;
+    std::vector<int> letter(kInputLayerNeurons + 1);
+    ParseEmnistLetter(ReadBenchLine(), letter.data());
+    for (size_t i = 0; i < kBenchEpochSize; ++i) {
+      letter[0] = i % kOutputLayerNeurons + 1;
+      letter[i % kInputLayerNeurons + 1] = i % 256;
+      batch.Add(i + 1, letter.data());
+    }
+    return batch;
+  }();
+  return data;
+}
+
+//  Exposes the training phases of a network to the benchmarks
+template <typename Net>
+class BenchNetwork : public Net {
+ public:
+  explicit BenchNetwork(int num_hidden_layers) : Net(num_hidden_layers) {
+    this->InitNetwork();
+    this->ReadEmnistLetter(ReadBenchLine());
+    Forward();
+  }
+
+  void Forward();
+  void Backward() { this->CalculateDeltaWeights_(this->emnist_letter_[0]); }
+  void Update() { this->UpdateWeights_(); }
+};
+
+template <>
+void BenchNetwork<MatrixNetwork>::Forward() {
+  std::unique_ptr<Matrix> vector(EmnistLetterToVector_());
+  CalculateVector_(vector.get());
+}
+
+template <>
+void BenchNetwork<GraphNetwork>::Forward() {
+  EmnistLetterToVector_();
+  CalculateVector_();
+}
+
+}  // namespace s21
+
+//  Matrix kernels, args are rows x inner * inner x cols
+static void BM_MatrixMul(benchmark::State& state) {
+  s21::Matrix vector(state.range(0), state.range(1));
+  s21::Matrix weights(state.range(1), state.range(2));
+  vector.RandomizeMatrix();
+  weights.RandomizeMatrix();
+  for (auto _ : state) {
+    s21::Matrix result = vector * weights;
+    benchmark::DoNotOptimize(result.GetRow(0));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1) * state.range(2));
+}
+BENCHMARK(BM_MatrixMul)
+    ->Args({1, s21::kInputLayerNeurons, s21::kHiddenLayerNeurons})
+    ->Args({1, s21::kHiddenLayerNeurons, s21::kHiddenLayerNeurons})
+    ->Args({1, s21::kHiddenLayerNeurons, s21::kOutputLayerNeurons})
+    ->Args({100, s21::kHiddenLayerNeurons, s21::kHiddenLayerNeurons});
+
+static void BM_MatrixMulWithSigmoid(benchmark::State& state) {
+  s21::Matrix vector(state.range(0), state.range(1));
+  s21::Matrix weights(state.range(1), state.range(2));
+  vector.RandomizeMatrix();
+  weights.RandomizeMatrix();
+  for (auto _ : state) {
+    s21::Matrix result(vector);
+    result.MulMatrixWithSigmoid(weights);
+    benchmark::DoNotOptimize(result.GetRow(0));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1) * state.range(2));
+}
+BENCHMARK(BM_MatrixMulWithSigmoid)
+    ->Args({1, s21::kInputLayerNeurons, s21::kHiddenLayerNeurons})
+    ->Args({1, s21::kHiddenLayerNeurons, s21::kHiddenLayerNeurons})
+    ->Args({1, s21::kHiddenLayerNeurons, s21::kOutputLayerNeurons});
+
+//  Training phases of one letter, arg is the number of hidden layers; the
+//  "layers" counter turns the time into a per-layer cost
+template <typename Net>
+static void BM_Forward(benchmark::State& state) {
+  s21::BenchNetwork<Net> net(state.range(0));
+  for (auto _ : state) {
+    net.Forward();
+  }
+  state.counters["layers"] = state.range(0) + 1;
+}
+BENCHMARK_TEMPLATE(BM_Forward, s21::MatrixNetwork)->Arg(2)->Arg(5);
+BENCHMARK_TEMPLATE(BM_Forward, s21::GraphNetwork)->Arg(2)->Arg(5);
+
+template <typename Net>
+static void BM_Backward(benchmark::State& state) {
+  s21::BenchNetwork<Net> net(state.range(0));
+  for (auto _ : state) {
+    net.Backward();
+  }
+  state.counters["layers"] = state.range(0) + 1;
+}
+BENCHMARK_TEMPLATE(BM_Backward, s21::MatrixNetwork)->Arg(2)->Arg(5);
+BENCHMARK_TEMPLATE(BM_Backward, s21::GraphNetwork)->Arg(2)->Arg(5);
+
+template <typename Net>
+static void BM_Update(benchmark::State& state) {
+  s21::BenchNetwork<Net> net(state.range(0));
+  net.Backward();
+  net.SetLearningRate(1e-9);
+  for (auto _ : state) {
+    net.Update();
+  }
+  state.counters["layers"] = state.range(0) + 1;
+}
+BENCHMARK_TEMPLATE(BM_Update, s21::MatrixNetwork)->Arg(2)->Arg(5);
+BENCHMARK_TEMPLATE(BM_Update, s21::GraphNetwork)->Arg(2)->Arg(5);
+
+//  Whole epochs over an in-memory dataset
+template <typename Net>
+static void BM_TrainEpoch(benchmark::State& state) {
+  s21::BenchNetwork<Net> net(s21::kNumHiddenLayers);
+  const s21::DataSet& data = s21::GetBenchDataSet();
+  for (auto _ : state) {
+    size_t count = 1;
+    for (; net.TrainNetwork(data, count, 0, 0);) {
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * data.GetSize());
+}
+BENCHMARK_TEMPLATE(BM_TrainEpoch, s21::MatrixNetwork)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_TrainEpoch, s21::GraphNetwork)
+    ->Unit(benchmark::kMillisecond);
+
+template <typename Net>
+static void BM_TestEpoch(benchmark::State& state) {
+  Net net;
+  net.LoadWeights(s21::kBenchWeights);
+  const s21::DataSet& data = s21::GetBenchDataSet();
+  for (auto _ : state) {
+    net.ResetStatistics();
+    size_t count = 1;
+    for (; net.TestNetwork(data, count, data.GetSize());) {
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * data.GetSize());
+}
+BENCHMARK_TEMPLATE(BM_TestEpoch, s21::MatrixNetwork)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_TestEpoch, s21::GraphNetwork)
+    ->Unit(benchmark::kMillisecond);
+
+template <typename Net>
+static void BM_Predict(benchmark::State& state) {
+  Net net;
+  net.LoadWeights(s21::kBenchWeights);
+  const uint8_t* image = s21::GetBenchDataSet().GetImage(0);
+  std::vector<int> input_layer(image, image + s21::kInputLayerNeurons);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(net.Predict(input_layer));
+  }
+}
+BENCHMARK_TEMPLATE(BM_Predict, s21::MatrixNetwork)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_Predict, s21::GraphNetwork)
+    ->Unit(benchmark::kMicrosecond);
+
+//  Threads sharing one network, each with its own workspace
+template <typename Net>
+static void BM_SharedForward(benchmark::State& state) {
+  static Net net;
+  if (state.thread_index() == 0) {
+    net.LoadWeights(s21::kBenchWeights);
+  }
+  const uint8_t* image = s21::GetBenchDataSet().GetImage(state.thread_index());
+  s21::InferenceWorkspace workspace;
+  std::vector<double> outputs(s21::kOutputLayerNeurons);
+  for (auto _ : state) {
+    net.Forward(image, outputs.data(), &workspace);
+    benchmark::DoNotOptimize(outputs.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_SharedForward, s21::MatrixNetwork)
+    ->ThreadRange(1, 4)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_SharedForward, s21::GraphNetwork)
+    ->ThreadRange(1, 4)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+//  Batched forward pass of the inference server, arg is the batch size
+template <typename Net>
+static void BM_PredictBatch(benchmark::State& state) {
+  Net net;
+  net.LoadWeights(s21::kBenchWeights);
+  const s21::DataSet& data = s21::GetBenchDataSet();
+  size_t count = state.range(0);
+  std::vector<uint8_t> images;
+  for (size_t i = 0; i < count; ++i) {
+    images.insert(images.end(), data.GetImage(i),
+                  data.GetImage(i) + s21::kInputLayerNeurons);
+  }
+  std::vector<double> outputs(count * s21::kOutputLayerNeurons);
+  for (auto _ : state) {
+    net.PredictBatch(images.data(), count, outputs.data());
+    benchmark::DoNotOptimize(outputs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_PredictBatch, s21::MatrixNetwork)
+    ->Arg(1)
+    ->Arg(32)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_PredictBatch, s21::GraphNetwork)
+    ->Arg(1)
+    ->Arg(32)
+    ->Unit(benchmark::kMicrosecond);
+
+//  Ensembles of arg copies of the bench model: one image with the models
+//  in parallel, and batches of 32 through the stacked first layer
+static s21::Ensemble MakeBenchEnsemble(size_t num_models) {
+  size_t num_layers = 0;
+  std::vector<double> weights;
+  s21::ReadWeights(s21::kBenchWeights, &num_layers, &weights);
+  auto model =
+      std::make_shared<const s21::WeightSnapshot>(1, num_layers, weights);
+  return s21::Ensemble(std::vector<std::shared_ptr<const s21::WeightSnapshot>>(
+      num_models, model));
+}
+
+static void BM_EnsemblePredict(benchmark::State& state) {
+  s21::Ensemble ensemble = MakeBenchEnsemble(state.range(0));
+  const uint8_t* image = s21::GetBenchDataSet().GetImage(0);
+  std::vector<int> input_layer(image, image + s21::kInputLayerNeurons);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ensemble.Predict(input_layer));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EnsemblePredict)
+    ->Arg(1)
+    ->Arg(3)
+    ->Arg(6)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_EnsemblePredictBatch(benchmark::State& state) {
+  s21::Ensemble ensemble = MakeBenchEnsemble(state.range(0));
+  const s21::DataSet& data = s21::GetBenchDataSet();
+  size_t count = 32;
+  std::vector<uint8_t> images;
+  for (size_t i = 0; i < count; ++i) {
+    images.insert(images.end(), data.GetImage(i),
+                  data.GetImage(i) + s21::kInputLayerNeurons);
+  }
+  std::vector<double> outputs(count * s21::kOutputLayerNeurons);
+  for (auto _ : state) {
+    ensemble.PredictBatch(images.data(), count, outputs.data());
+    benchmark::DoNotOptimize(outputs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_EnsemblePredictBatch)
+    ->Arg(1)
+    ->Arg(3)
+    ->Arg(6)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+//  Parsing
+static void BM_ParseEmnistLetter(benchmark::State& state) {
+  std::string line = s21::ReadBenchLine();
+  int letter[s21::kInputLayerNeurons + 1];
+  for (auto _ : state) {
+    s21::ParseEmnistLetter(line, letter);
+    benchmark::DoNotOptimize(letter);
+  }
+  state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_ParseEmnistLetter);
+
+static void BM_ReadEmnistLetter(benchmark::State& state) {
+  std::string line = s21::ReadBenchLine();
+  s21::MatrixNetwork mn;
+  for (auto _ : state) {
+    mn.ReadEmnistLetter(line);
+    benchmark::DoNotOptimize(mn.GetEmnistLetter().data());
+  }
+  state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_ReadEmnistLetter);
+
+template <typename Net>
+static void BM_LoadWeights(benchmark::State& state) {
+  Net net;
+  for (auto _ : state) {
+    net.LoadWeights(s21::kBenchWeights);
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          std::filesystem::file_size(s21::kBenchWeights));
+}
+BENCHMARK_TEMPLATE(BM_LoadWeights, s21::MatrixNetwork)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_LoadWeights, s21::GraphNetwork)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,187 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "tracer.h"
+
+namespace s21 {
+
+void TakeCheckpoint(Network* network, Checkpoint* checkpoint) {
+  MLP_TRACE_SPAN("take checkpoint");
+  checkpoint->type = network->GetType();
+  checkpoint->num_layers = network->GetNumLayers();
+  network->GetWeights(&checkpoint->weights);
+  checkpoint->learning_rate = network->GetLearningRate();
+  checkpoint->curve = network->GetTrainingCurve();
+}
+
+void RestoreCheckpoint(const Checkpoint& checkpoint, Network* network) {
+  network->SetWeights(checkpoint.num_layers, checkpoint.weights);
+  network->SetLearningRate(checkpoint.learning_rate);
+  network->SetTrainingCurve(checkpoint.curve);
+}
+
+template <typename T>
+static void WriteVector(std::ofstream* out, const std::vector<T>& values) {
+  out->write(reinterpret_cast<const char*>(values.data()),
+             values.size() * sizeof(T));
+}
+
+template <typename T>
+static std::vector<T> ReadVector(std::ifstream* in, uint64_t size) {
+  std::vector<T> values(size);
+  in->read(reinterpret_cast<char*>(values.data()), size * sizeof(T));
+  return values;
+}
+
+void SaveCheckpoint(const Checkpoint& checkpoint,
+                    const std::string& checkpoint_file) {
+  MLP_TRACE_SPAN("save checkpoint");
+  std::string tmp_file = checkpoint_file + ".tmp";
+  std::ofstream out(tmp_file, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::invalid_argument("Error: can't save the " + checkpoint_file);
+  }
+  const TrainingCurve& curve = checkpoint.curve;
+  CheckpointHeader header{};
+  std::memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+  header.version = kCheckpointVersion;
+  header.type = checkpoint.type;
+  header.num_layers = static_cast<uint32_t>(checkpoint.num_layers);
+  header.seed = checkpoint.seed;
+  header.epoch = checkpoint.epoch;
+  header.num_epochs = checkpoint.num_epochs;
+  header.cursor = checkpoint.cursor;
+  header.num_weights = checkpoint.weights.size();
+  header.num_batch_points = curve.GetBatches().size();
+  header.num_epoch_points = curve.GetEpochs().size();
+  header.num_test_accuracies = checkpoint.test_accuracy.size();
+  header.learning_rate = checkpoint.learning_rate;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  WriteVector(&out, checkpoint.weights);
+  out.write(reinterpret_cast<const char*>(&curve.GetEpochSums()),
+            sizeof(TrainingPoint));
+  WriteVector(&out, curve.GetBatches());
+  WriteVector(&out, curve.GetEpochs());
+  WriteVector(&out, checkpoint.test_accuracy);
+  out.close();
+  if (!out || std::rename(tmp_file.c_str(), checkpoint_file.c_str()) != 0) {
+    std::remove(tmp_file.c_str());
+    throw std::invalid_argument("Error: can't save the " + checkpoint_file);
+  }
+}
+
+Checkpoint LoadCheckpoint(const std::string& checkpoint_file) {
+  std::ifstream in(checkpoint_file, std::ios::binary);
+  if (!in.is_open()) {
+    throw std::invalid_argument("Error: can't open the " + checkpoint_file);
+  }
+  in.seekg(0, std::ios::end);
+  uint64_t size = in.tellg();
+  in.seekg(0);
+  CheckpointHeader header;
+  if (size < sizeof(header) ||
+      !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) !=
+          0 ||
+      header.version != kCheckpointVersion || header.type > kGraphNet ||
+      header.epoch < 1 ||
+      sizeof(header) + (header.num_weights + header.num_test_accuracies) *
+                               sizeof(double) +
+              (header.num_batch_points + header.num_epoch_points + 1) *
+                  sizeof(TrainingPoint) !=
+          size) {
+    throw std::invalid_argument("Error: incorrect format of " +
+                                checkpoint_file);
+  }
+  Checkpoint checkpoint;
+  checkpoint.type = static_cast<net_type>(header.type);
+  checkpoint.num_layers = header.num_layers;
+  checkpoint.learning_rate = header.learning_rate;
+  checkpoint.seed = header.seed;
+  checkpoint.epoch = header.epoch;
+  checkpoint.num_epochs = header.num_epochs;
+  checkpoint.cursor = header.cursor;
+  checkpoint.weights = ReadVector<double>(&in, header.num_weights);
+  TrainingPoint epoch_sums;
+  in.read(reinterpret_cast<char*>(&epoch_sums), sizeof(epoch_sums));
+  std::vector<TrainingPoint> batches =
+      ReadVector<TrainingPoint>(&in, header.num_batch_points);
+  std::vector<TrainingPoint> epochs =
+      ReadVector<TrainingPoint>(&in, header.num_epoch_points);
+  checkpoint.curve.Restore(epoch_sums, std::move(batches), std::move(epochs));
+  checkpoint.test_accuracy =
+      ReadVector<double>(&in, header.num_test_accuracies);
+  if (!in || checkpoint.weights.size() != CountWeights(header.num_layers)) {
+    throw std::invalid_argument("Error: incorrect format of " +
+                                checkpoint_file);
+  }
+  return checkpoint;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& checkpoint_file)
+    : checkpoint_file_(checkpoint_file),
+      writing_(false),
+      stop_(false),
+      num_written_(0) {
+  thread_ = std::thread(&CheckpointWriter::Work_, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void CheckpointWriter::Write(Checkpoint checkpoint) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = std::make_unique<Checkpoint>(std::move(checkpoint));
+  }
+  wake_.notify_one();
+}
+
+void CheckpointWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return !pending_ && !writing_; });
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void CheckpointWriter::Work_() {
+  Tracer::GetInstance().SetThreadName("checkpoint writer");
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this] { return stop_ || pending_; });
+    if (!pending_) {
+      break;
+    }
+    std::unique_ptr<Checkpoint> checkpoint = std::move(pending_);
+    writing_ = true;
+    lock.unlock();
+    try {
+      SaveCheckpoint(*checkpoint, checkpoint_file_);
+      ++num_written_;
+    } catch (...) {
+      lock.lock();
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+      lock.unlock();
+    }
+    lock.lock();
+    writing_ = false;
+    idle_.notify_all();
+  }
+}
+
+}  // namespace s21
@@ -0,0 +1,114 @@
+#ifndef SRC_CHECKPOINT_H_
+#define SRC_CHECKPOINT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "network.h"
+
+namespace s21 {
+
+//  Checkpoint file: a CheckpointHeader, the weights, the epoch sums of the
+//  training curve, its batch and epoch points and the test accuracy of
+//  every finished epoch, all in host order
+
+const char kCheckpointMagic[4] = {'M', 'L', 'P', 'C'};
+const uint32_t kCheckpointVersion = 1;
+const std::string kCheckpointFile = "./weights/checkpoint.bin";
+//  Training batches between two checkpoints
+const size_t kCheckpointBatches = 10;
+
+//  An empty file means no checkpoints
+struct CheckpointOptions {
+  std::string file;
+  size_t every_batches = kCheckpointBatches;
+};
+
+struct CheckpointHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t type;
+  uint32_t num_layers;
+  uint32_t seed;
+  int32_t epoch;
+  int32_t num_epochs;
+  uint32_t reserved;
+  uint64_t cursor;
+  uint64_t num_weights;
+  uint64_t num_batch_points;
+  uint64_t num_epoch_points;
+  uint64_t num_test_accuracies;
+  double learning_rate;
+};
+
+//  Everything a training run needs to continue as if it never stopped. The
+//  order of an epoch is ShuffleIndices(size, seed + epoch); cursor is the
+//  1-based index of its next sample, as the count of TrainNetwork
+struct Checkpoint {
+  net_type type;
+  size_t num_layers;
+  std::vector<double> weights;
+  double learning_rate;
+  uint32_t seed;
+  int epoch;
+  int num_epochs;
+  size_t cursor;
+  TrainingCurve curve;
+  //  One per finished epoch, negative without a test pass
+  std::vector<double> test_accuracy;
+};
+
+//  Copies the weights, learning rate and curve of a network into
+//  checkpoint; cheap enough to be taken between two batches
+void TakeCheckpoint(Network* network, Checkpoint* checkpoint);
+//  Puts them back, the network may be of either type
+void RestoreCheckpoint(const Checkpoint& checkpoint, Network* network);
+
+//  Written to a temporary file that is renamed over checkpoint_file, so a
+//  crash leaves the previous checkpoint intact
+void SaveCheckpoint(const Checkpoint& checkpoint,
+                    const std::string& checkpoint_file);
+Checkpoint LoadCheckpoint(const std::string& checkpoint_file);
+
+//  Saves checkpoints on its own thread. Only the newest is kept while one
+//  is being written, so a slow disk never holds back training
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(const std::string& checkpoint_file);
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+  //  Writes the pending checkpoint, errors are dropped
+  ~CheckpointWriter();
+
+  void Write(Checkpoint checkpoint);
+  //  Waits until the pending checkpoint is saved and rethrows the first
+  //  error of a write
+  void Flush();
+  size_t GetNumWritten() const { return num_written_.load(); }
+
+ private:
+  std::string checkpoint_file_;
+  std::unique_ptr<Checkpoint> pending_;
+  bool writing_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::atomic<size_t> num_written_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::thread thread_;
+
+  void Work_();
+};
+
+}  // namespace s21
+
+#endif  //  SRC_CHECKPOINT_H_
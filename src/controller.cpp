@@ -0,0 +1,3 @@
+#include "controller.h"
+
+s21::Controller* s21::Controller::controller_ = nullptr;
@@ -1,11 +1,24 @@
 #ifndef SRC_CONTROLLER_H_
 #define SRC_CONTROLLER_H_
 
+#include "checkpoint.h"
+#include "crossvalidation.h"
+#include "dataloader.h"
+#include "ensemble.h"
 #include "graphnetwork.h"
+#include "imagebatch.h"
+#include "jobrunner.h"
 #include "matrixnetwork.h"
+#include "modelregistry.h"
+#include "preprocess.h"
+#include "server.h"
+#include "snapshot.h"
+#include "threadpool.h"
 
 namespace s21 {
 
+const std::string kWeightsLoaded = "Weights uploaded successfully";
+
 class Controller {
  public:
   static Controller* GetInstance() {
@@ -53,6 +66,7 @@ class Controller {
   }
 
   void SetLearningRate(double lr) { current_network_->SetLearningRate(lr); }
+  double GetLearningRate() { return current_network_->GetLearningRate(); }
 
   size_t GetCountErrors() { return current_network_->GetCountErrors(); }
   double CalculateAccuracy() {
@@ -65,6 +79,40 @@ class Controller {
   double CalculateFmeasure() {
     return current_network_->CalculateFmeasure() * 100;
   }
+  const std::vector<s21::TrainingPoint>& GetBatchCurve() {
+    return current_network_->GetTrainingCurve().GetBatches();
+  }
+  const std::vector<s21::TrainingPoint>& GetEpochCurve() {
+    return current_network_->GetTrainingCurve().GetEpochs();
+  }
+  void FinishTrainingEpoch() { current_network_->FinishTrainingEpoch(); }
+  void ResetTrainingCurve() { current_network_->ResetTrainingCurve(); }
+
+  //  The pool shared by all parallel work; don't resize it while any runs
+  s21::ThreadPool* GetThreadPool() { return pool_.get(); }
+  void SetThreadPool(size_t num_threads, bool pin_threads) {
+    if (jobs_.IsRunning()) {
+      throw std::invalid_argument("Error: a job is running");
+    }
+    auto pool = std::make_unique<s21::ThreadPool>(num_threads, pin_threads);
+    s21::ThreadPool::SetDefault(pool.get());
+    pool_ = std::move(pool);
+  }
+
+  s21::Profiler* GetProfiler() { return current_network_->GetProfiler(); }
+  s21::ProfileReport GetProfile() {
+    return current_network_->GetProfiler()->GetReport();
+  }
+  void ResetProfile() { current_network_->GetProfiler()->Reset(); }
+
+  //  Timeline of the training/evaluation pipeline as Chrome trace JSON
+  void StartTrace() { s21::Tracer::GetInstance().Start(); }
+  void DumpTrace(const std::string& trace_file) {
+    s21::Tracer::GetInstance().Stop();
+    s21::Tracer::GetInstance().Dump(trace_file);
+  }
+
+  s21::MetricsReport GetMetrics() { return current_network_->GetMetrics(); }
   void ResetStatistics() { current_network_->ResetStatistics(); }
 
   void SaveWeights(const std::string& weights_file) {
@@ -73,32 +121,227 @@ class Controller {
   std::string LoadWeights(const std::string& weights_file) {
     try {
       current_network_->LoadWeights(weights_file);
-      return "Weights uploaded successfully";
+      return kWeightsLoaded;
     } catch (const std::exception& e) {
       return e.what();
     }
   }
 
-  bool TrainNetwork(std::ifstream& fp, size_t& count, size_t g_begin,
+  bool TrainNetwork(std::istream& fp, size_t& count, size_t g_begin,
                     size_t g_end) {
     return current_network_->TrainNetwork(fp, count, g_begin, g_end);
   }
 
-  bool TestNetwork(std::ifstream& fp, size_t& count, size_t max_tests) {
+  bool TestNetwork(std::istream& fp, size_t& count, size_t max_tests) {
     return current_network_->TestNetwork(fp, count, max_tests);
   }
 
+  std::unique_ptr<s21::DataSet> OpenDataSet(const std::string& data_file) {
+    return s21::OpenDataSet(data_file);
+  }
+  std::unique_ptr<s21::DataSet> LoadDataSet(const std::string& data_file) {
+    return s21::LoadDataSet(data_file);
+  }
+  s21::Fold MakeFold(const s21::DataSet& data, size_t num_folds, size_t fold) {
+    return s21::MakeFold(data, num_folds, fold);
+  }
+
+  bool TrainNetwork(const s21::DataSet& data, size_t& count, size_t g_begin,
+                    size_t g_end) {
+    return current_network_->TrainNetwork(data, count, g_begin, g_end);
+  }
+
+  bool TestNetwork(const s21::DataSet& data, size_t& count, size_t max_tests) {
+    return current_network_->TestNetwork(data, count, max_tests);
+  }
+
+  bool TrainNetwork(s21::DataLoader& loader, size_t& count, size_t g_begin,
+                    size_t g_end) {
+    return current_network_->TrainNetwork(loader, count, g_begin, g_end);
+  }
+
+  bool TestNetwork(s21::DataLoader& loader, size_t& count, size_t max_tests) {
+    return current_network_->TestNetwork(loader, count, max_tests);
+  }
+
+  //  Background jobs on the current network, polled with GetJobProgress
+  void StartTraining(const s21::DataSet& train, const s21::DataSet* test,
+                     int num_epochs,
+                     const s21::CheckpointOptions& checkpoints = {}) {
+    jobs_.StartTraining(current_network_, train, test, num_epochs,
+                        checkpoints);
+  }
+  //  Switches to the network type of the checkpoint and continues its run
+  void ResumeTraining(const s21::DataSet& train, const s21::DataSet* test,
+                      const std::string& checkpoint_file,
+                      const s21::CheckpointOptions& checkpoints = {}) {
+    s21::Checkpoint checkpoint = s21::LoadCheckpoint(checkpoint_file);
+    if (jobs_.IsRunning()) {
+      throw std::invalid_argument("Error: a job is already running");
+    }
+    SetCurrentNetwork(checkpoint.type);
+    jobs_.ResumeTraining(current_network_, train, test, checkpoint,
+                         checkpoints);
+  }
+  void StartTesting(const s21::DataSet& test, size_t max_tests) {
+    jobs_.StartTesting(current_network_, test, max_tests);
+  }
+  void StartCrossValidation(const s21::DataSet& data,
+                            const s21::CrossValidationOptions& options) {
+    jobs_.StartCrossValidation(data, options);
+  }
+  s21::JobProgress GetJobProgress() { return jobs_.GetProgress(); }
+  bool IsJobRunning() { return jobs_.IsRunning(); }
+  void PauseJob() { jobs_.Pause(); }
+  void ResumeJob() { jobs_.Resume(); }
+  void CancelJob() { jobs_.Cancel(); }
+  void WaitJob() { jobs_.Wait(); }
+  const std::vector<s21::EpochResult>& GetEpochResults() {
+    return jobs_.GetEpochResults();
+  }
+  const std::vector<s21::FoldResult>& GetFolds() { return jobs_.GetFolds(); }
+
+  std::vector<s21::FoldResult> RunCrossValidation(
+      const s21::DataSet& data, const s21::CrossValidationOptions& options) {
+    return s21::RunCrossValidation(data, options);
+  }
+
   int Predict(const std::vector<int>& input_layer) {
     return current_network_->Predict(input_layer);
   }
+  //  Letter of a decoded image, averaged down to the input layer
+  int PredictImage(const s21::InkImage& image) {
+    uint8_t input[s21::kInputLayerNeurons];
+    s21::PreprocessImage(image, input);
+    return current_network_->Predict(
+        std::vector<int>(input, input + s21::kInputLayerNeurons));
+  }
+  void PredictBatch(const uint8_t* images, size_t count, double* outputs) {
+    current_network_->PredictBatch(images, count, outputs);
+  }
+  //  Letters of the BMP images of a directory, passed to sink in the order
+  //  of their names as the batches finish
+  s21::ClassifyStats ClassifyDirectory(const std::string& dir,
+                                       const s21::ImageSink& sink) {
+    s21::Network* network = current_network_;
+    return s21::ClassifyImages(
+        s21::ListImages(dir),
+        [network](const uint8_t* images, size_t count, double* outputs) {
+          network->PredictBatch(images, count, outputs);
+        },
+        sink);
+  }
+
+  //  Models by name (those of kWeightsDir) or weights file, picked per
+  //  call without touching the current network
+  s21::ModelRegistry* GetModels() { return &models_; }
+  int PredictModel(const std::string& model,
+                   const std::vector<int>& input_layer) {
+    return models_.Get(model)->Predict(input_layer);
+  }
+  void PredictBatchModel(const std::string& model, const uint8_t* images,
+                         size_t count, double* outputs) {
+    models_.Get(model)->PredictBatch(images, count, outputs);
+  }
+  s21::MetricsReport TestModel(const std::string& model,
+                               const s21::DataSet& data, size_t max_tests) {
+    return s21::ComputeMetrics(models_.Get(model)->Test(data, max_tests));
+  }
+  s21::ClassifyStats ClassifyDirectoryModel(const std::string& model,
+                                            const std::string& dir,
+                                            const s21::ImageSink& sink) {
+    std::shared_ptr<const s21::WeightSnapshot> loaded = models_.Get(model);
+    return s21::ClassifyImages(
+        s21::ListImages(dir),
+        [loaded](const uint8_t* images, size_t count, double* outputs) {
+          loaded->PredictBatch(images, count, outputs);
+        },
+        sink);
+  }
+
+  //  Models of the registry answering as one, loaded at once
+  void SetEnsemble(const std::vector<std::string>& models,
+                   s21::ensemble_mode mode) {
+    models_.Preload(models);
+    std::vector<std::shared_ptr<const s21::WeightSnapshot>> loaded;
+    for (auto& it : models) {
+      loaded.push_back(models_.Get(it));
+    }
+    ensemble_ = std::make_shared<const s21::Ensemble>(std::move(loaded), mode);
+  }
+  std::shared_ptr<const s21::Ensemble> GetEnsemble() { return ensemble_; }
+  int PredictEnsemble(const std::vector<int>& input_layer) {
+    return CheckEnsemble_()->Predict(input_layer);
+  }
+  void PredictBatchEnsemble(const uint8_t* images, size_t count,
+                            double* outputs) {
+    CheckEnsemble_()->PredictBatch(images, count, outputs);
+  }
+  s21::MetricsReport TestEnsemble(const s21::DataSet& data, size_t max_tests) {
+    return s21::ComputeMetrics(CheckEnsemble_()->Test(data, max_tests));
+  }
+  s21::ClassifyStats ClassifyDirectoryEnsemble(const std::string& dir,
+                                               const s21::ImageSink& sink) {
+    std::shared_ptr<const s21::Ensemble> ensemble = CheckEnsemble_();
+    return s21::ClassifyImages(
+        s21::ListImages(dir),
+        [ensemble](const uint8_t* images, size_t count, double* outputs) {
+          ensemble->PredictBatch(images, count, outputs);
+        },
+        sink);
+  }
+
+  //  Weights published by training jobs, readable while they train
+  s21::SnapshotStore* GetSnapshots() { return &snapshots_; }
+  uint64_t PublishSnapshot() { return snapshots_.Publish(current_network_); }
+  void PredictSnapshot(const uint8_t* images, size_t count, double* outputs) {
+    s21::SnapshotPin snapshot = snapshots_.Pin();
+    if (!snapshot) {
+      throw std::invalid_argument("Error: no weights published");
+    }
+    snapshot->PredictBatch(images, count, outputs);
+  }
+
+  //  Serves the published snapshots until the server is destroyed: the
+  //  current weights, then those of a training job as it goes
+  std::unique_ptr<s21::InferenceServer> StartServer(
+      const s21::ServerOptions& options) {
+    if (!jobs_.IsRunning()) {
+      PublishSnapshot();
+    }
+    auto server = std::make_unique<s21::InferenceServer>(&snapshots_, options);
+    server->Start();
+    return server;
+  }
 
  private:
   static Controller* controller_;
   s21::MatrixNetwork* matrix_instance_;
   s21::GraphNetwork* graph_instance_;
   s21::Network* current_network_;
+  std::unique_ptr<s21::ThreadPool> pool_;
+  s21::SnapshotStore snapshots_;
+  s21::ModelRegistry models_;
+  std::shared_ptr<const s21::Ensemble> ensemble_;
+  //  After the pool and snapshots, so a job is stopped before they go
+  s21::JobRunner jobs_;
 
-  Controller() {}
+  Controller() : pool_(std::make_unique<s21::ThreadPool>()) {
+    s21::ThreadPool::SetDefault(pool_.get());
+    jobs_.SetSnapshots(&snapshots_);
+    try {
+      models_.RegisterDirectory(s21::kWeightsDir);
+    } catch (const std::exception&) {
+      //  No weights shipped, models are given by file
+    }
+  }
+
+  std::shared_ptr<const s21::Ensemble> CheckEnsemble_() {
+    if (!ensemble_) {
+      throw std::invalid_argument("Error: no ensemble");
+    }
+    return ensemble_;
+  }
 };
 
 }  //   namespace s21
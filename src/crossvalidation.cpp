@@ -0,0 +1,136 @@
+#include "crossvalidation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT(*)
+#include <cstdlib>
+#include <exception>
+#include <memory>
+
+#include "graphnetwork.h"
+#include "matrixnetwork.h"
+#include "threadpool.h"
+#include "tracer.h"
+
+namespace s21 {
+
+static FoldResult RunFold(Network* network, const DataSet& data,
+                          const CrossValidationOptions& options, size_t fold) {
+  MLP_TRACE_SPAN("fold");
+  auto begin = std::chrono::steady_clock::now();
+  Fold views = MakeFold(data, options.num_folds, fold);
+  for (int epoch = 1; epoch <= options.num_epochs; ++epoch) {
+    DataSetView epoch_data(
+        views.train,
+        ShuffleIndices(views.train.GetSize(),
+                       options.seed + fold * options.num_epochs + epoch));
+    size_t count = 1;
+    for (; network->TrainNetwork(epoch_data, count, 0, 0);) {
+    }
+  }
+  network->ResetStatistics();
+  size_t count = 1;
+  {
+    MLP_TRACE_SPAN("test pass");
+    for (; network->TestNetwork(views.validation, count,
+                                views.validation.GetSize());) {
+    }
+  }
+  std::chrono::duration<double> duration =
+      std::chrono::steady_clock::now() - begin;
+
+  FoldResult result;
+  result.counts = network->GetConfusionCounts();
+  MetricsReport metrics = ComputeMetrics(result.counts);
+  result.fold = fold;
+  result.num_tests = views.validation.GetSize();
+  result.num_errors = metrics.errors;
+  result.accuracy = metrics.accuracy;
+  result.precision = metrics.macro_precision;
+  result.recall = metrics.macro_recall;
+  result.fmeasure = metrics.macro_fmeasure;
+  result.time = duration.count();
+  return result;
+}
+
+std::vector<FoldResult> RunCrossValidation(
+    const DataSet& data, const CrossValidationOptions& options) {
+  if (options.num_folds < 2 || options.num_folds > data.GetSize()) {
+    throw std::out_of_range("Error: incorrect number of folds");
+  }
+
+  //  Networks are created here because initialization draws from std::rand.
+  //  The constructors seed it with the time, which is the same for all the
+  //  folds, so each fold is seeded from options.seed instead
+  std::vector<std::unique_ptr<Network>> networks;
+  for (size_t i = 0; i < options.num_folds; ++i) {
+    if (options.type == kMatrixNet) {
+      networks.push_back(
+          std::make_unique<MatrixNetwork>(options.num_hidden_layers));
+    } else {
+      networks.push_back(
+          std::make_unique<GraphNetwork>(options.num_hidden_layers));
+    }
+    std::srand(options.seed + i);
+    networks.back()->InitNetwork();
+    networks.back()->SetLearningRate(options.learning_rate);
+  }
+
+  ThreadPool* pool = options.pool ? options.pool : ThreadPool::GetDefault();
+  size_t num_threads = options.num_threads;
+  if (num_threads == 0) {
+    num_threads = pool->GetSize() + 1;
+  }
+  num_threads = std::min(num_threads, options.num_folds);
+
+  std::vector<FoldResult> results(options.num_folds);
+  std::vector<std::exception_ptr> errors(options.num_folds);
+  std::atomic<size_t> next_fold(0);
+  auto worker = [&] {
+    for (size_t fold = next_fold++; fold < options.num_folds;
+         fold = next_fold++) {
+      try {
+        results[fold] = RunFold(networks[fold].get(), data, options, fold);
+      } catch (...) {
+        errors[fold] = std::current_exception();
+      }
+    }
+  };
+  //  The calling thread is one of the workers
+  TaskGroup workers(pool);
+  for (size_t i = 1; i < num_threads; ++i) {
+    workers.Run(worker);
+  }
+  worker();
+  workers.Wait();
+  for (auto& it : errors) {
+    if (it) {
+      std::rethrow_exception(it);
+    }
+  }
+  return results;
+}
+
+FoldResult AverageFolds(const std::vector<FoldResult>& folds) {
+  FoldResult result{};
+  result.fold = folds.size();
+  for (auto& it : folds) {
+    result.num_tests += it.num_tests;
+    result.num_errors += it.num_errors;
+    result.accuracy += it.accuracy;
+    result.precision += it.precision;
+    result.recall += it.recall;
+    result.fmeasure += it.fmeasure;
+    result.time = std::max(result.time, it.time);
+    result.counts.Merge(it.counts);
+  }
+  if (!folds.empty()) {
+    result.accuracy /= folds.size();
+    result.precision /= folds.size();
+    result.recall /= folds.size();
+    result.fmeasure /= folds.size();
+  }
+  return result;
+}
+
+}  // namespace s21
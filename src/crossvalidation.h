@@ -0,0 +1,53 @@
+#ifndef SRC_CROSSVALIDATION_H_
+#define SRC_CROSSVALIDATION_H_
+
+#include <vector>
+
+#include "dataset.h"
+#include "metrics.h"
+#include "network.h"
+#include "threadpool.h"
+
+namespace s21 {
+
+struct CrossValidationOptions {
+  net_type type = kMatrixNet;
+  int num_hidden_layers = kNumHiddenLayers;
+  double learning_rate = 0.4;
+  size_t num_folds = 5;
+  int num_epochs = 1;
+  //  Folds trained at once, 0 means the pool workers plus the caller
+  size_t num_threads = 0;
+  uint32_t seed = kShuffleSeed;
+  //  nullptr means the default pool
+  ThreadPool* pool = nullptr;
+};
+
+struct FoldResult {
+  size_t fold;
+  size_t num_tests;
+  size_t num_errors;
+  double accuracy;
+  double precision;
+  double recall;
+  double fmeasure;
+  double time;
+  ConfusionCounts counts;
+};
+
+//  Trains num_folds independent networks concurrently on the thread pool
+//  over one shared read-only dataset, each validated on its held-out fold.
+//  The weights of fold i start from std::srand(seed + i), so a run is
+//  repeatable. Metrics are fractions (0..1), time is the wall time of the
+//  fold in seconds
+std::vector<FoldResult> RunCrossValidation(
+    const DataSet& data, const CrossValidationOptions& options);
+
+//  Mean of the per-fold metrics (fold is set to the number of folds), counts
+//  are the merged counts of all folds. The folds run concurrently, so time
+//  is the wall time of the slowest fold rather than a mean
+FoldResult AverageFolds(const std::vector<FoldResult>& folds);
+
+}  // namespace s21
+
+#endif  //  SRC_CROSSVALIDATION_H_
@@ -0,0 +1,265 @@
+#include "dataloader.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT(*)
+#include <fstream>
+#include <stdexcept>
+#include <thread>  // NOLINT(*)
+
+#include "decompressor.h"
+#include "tracer.h"
+
+namespace s21 {
+
+void SampleBatch::Clear() {
+  records_.clear();
+  indices_.clear();
+}
+
+void SampleBatch::Add(size_t line_index, const int* letter) {
+  if (letter[0] < 1 || letter[0] > kOutputLayerNeurons) {
+    throw std::invalid_argument("Error, incorrect dataset format in line " +
+                                std::to_string(line_index));
+  }
+  size_t offset = records_.size();
+  records_.resize(offset + kRecordSize);
+  for (size_t i = 0; i < kRecordSize; ++i) {
+    if (letter[i] < 0 || letter[i] > 255) {
+      throw std::invalid_argument("Error, incorrect dataset format in line " +
+                                  std::to_string(line_index));
+    }
+    records_[offset + i] = static_cast<uint8_t>(letter[i]);
+  }
+  indices_.push_back(line_index);
+}
+
+//  Runs queued pool tasks (the reader may be one of them), then spins
+//  briefly and backs off to short sleeps so the consumer does not burn a
+//  core; returns the time spent in nanoseconds
+template <typename Ready>
+static size_t Wait(Ready ready, ThreadPool* pool) {
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; !ready(); ++i) {
+    if (pool->RunPending()) {
+      i = 0;
+    } else if (i < 64) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+//  The span of a reader filling one batch
+static void TraceBatch(uint64_t begin) {
+  Tracer& tracer = Tracer::GetInstance();
+  if (tracer.IsEnabled()) {
+    tracer.Record("read batch", begin, Tracer::Now());
+  }
+}
+
+DataLoader::DataLoader(const std::string& data_file, size_t num_readers,
+                       size_t queue_depth, size_t batch_size, ThreadPool* pool)
+    : data_file_(data_file),
+      batch_size_(batch_size),
+      pool_(pool),
+      readers_(pool),
+      stop_(false),
+      num_split_(0),
+      num_lines_(0),
+      input_ended_(false),
+      next_batch_(0),
+      has_current_(false),
+      consumer_stalls_(0),
+      consumer_stall_time_(0) {
+  if (num_readers < 1 || queue_depth < 1 || batch_size < 1) {
+    throw std::invalid_argument("Error: incorrect loader parameters");
+  }
+  if (!std::ifstream(data_file_).is_open()) {
+    throw std::invalid_argument("Error: can't open the " + data_file_);
+  }
+  //  A compressed stream can't be split, one reader parses behind the
+  //  decompression thread
+  if (IsCompressedFile(data_file_)) {
+    num_readers = 1;
+  }
+  for (size_t i = 0; i < num_readers; ++i) {
+    rings_.push_back(new Ring(queue_depth));
+  }
+  for (size_t i = 0; i < num_readers; ++i) {
+    Schedule_(i);
+  }
+}
+
+DataLoader::~DataLoader() {
+  stop_ = true;
+  //  Readers catch their errors, nothing to rethrow
+  readers_.Wait();
+  for (auto& it : rings_) {
+    delete it;
+  }
+}
+
+const SampleBatch* DataLoader::Next() {
+  if (has_current_) {
+    Ring* ring = rings_[next_batch_ % rings_.size()];
+    //  Sequentially consistent with the reader giving up its task, so
+    //  either the reader sees the free slot or it is scheduled here
+    ring->head_.store(ring->head_.load(std::memory_order_relaxed) + 1);
+    Schedule_(next_batch_ % rings_.size());
+    has_current_ = false;
+    ++next_batch_;
+  }
+  Ring* ring = rings_[next_batch_ % rings_.size()];
+  size_t head = ring->head_.load(std::memory_order_relaxed);
+  auto ready = [&] {
+    return ring->tail_.load(std::memory_order_acquire) != head ||
+           ring->done_.load(std::memory_order_acquire);
+  };
+  if (!ready()) {
+    MLP_TRACE_SPAN("wait batch");
+    ++consumer_stalls_;
+    consumer_stall_time_ += Wait(ready, pool_);
+  }
+  if (ring->tail_.load(std::memory_order_acquire) == head) {
+    if (ring->error_) {
+      std::rethrow_exception(ring->error_);
+    }
+    return nullptr;
+  }
+  has_current_ = true;
+  return &ring->slots_[head % ring->slots_.size()];
+}
+
+LoaderStats DataLoader::GetStats() const {
+  LoaderStats stats{};
+  stats.batches = next_batch_ + (has_current_ ? 1 : 0);
+  for (auto& it : rings_) {
+    stats.queue_depth += it->tail_.load(std::memory_order_acquire) -
+                         it->head_.load(std::memory_order_acquire);
+    stats.producer_stalls += it->stalls_.load(std::memory_order_relaxed);
+    stats.producer_stall_time +=
+        it->stall_time_.load(std::memory_order_relaxed) * 1e-9;
+  }
+  stats.consumer_stalls = consumer_stalls_;
+  stats.consumer_stall_time = consumer_stall_time_ * 1e-9;
+  return stats;
+}
+
+void DataLoader::Schedule_(size_t reader) {
+  Ring* ring = rings_[reader];
+  if (!ring->done_.load(std::memory_order_acquire) &&
+      !ring->scheduled_.exchange(true)) {
+    readers_.Run([this, reader] { Read_(reader); });
+  }
+}
+
+void DataLoader::Read_(size_t reader) {
+  Ring* ring = rings_[reader];
+  if (ring->paused_at_) {
+    ring->stall_time_ += Tracer::Now() - ring->paused_at_;
+    ring->paused_at_ = 0;
+  }
+  while (!Fill_(reader)) {
+    //  The ring is full; the task ends unless the consumer freed a slot
+    //  before it could see that the reader stopped
+    ++ring->stalls_;
+    ring->paused_at_ = Tracer::Now();
+    ring->scheduled_.store(false);
+    bool expected = false;
+    if (stop_ ||
+        ring->tail_.load(std::memory_order_relaxed) - ring->head_.load() >=
+            ring->slots_.size() ||
+        !ring->scheduled_.compare_exchange_strong(expected, true)) {
+      return;
+    }
+    ring->stall_time_ += Tracer::Now() - ring->paused_at_;
+    ring->paused_at_ = 0;
+  }
+  ring->done_.store(true, std::memory_order_release);
+}
+
+//  Parses batches until the ring is full (false) or the file, an error or
+//  a stop ends the reader (true)
+bool DataLoader::Fill_(size_t reader) {
+  Ring* ring = rings_[reader];
+  try {
+    std::vector<int> letter(kInputLayerNeurons + 1);
+    RawBatch raw;
+    while (!stop_) {
+      size_t tail = ring->tail_.load(std::memory_order_relaxed);
+      if (tail - ring->head_.load(std::memory_order_acquire) >=
+          ring->slots_.size()) {
+        return false;
+      }
+      if (!Split_(reader, &raw)) {
+        break;
+      }
+      if (raw.error) {
+        std::rethrow_exception(raw.error);
+      }
+      uint64_t batch_begin = Tracer::Now();
+      SampleBatch* batch = &ring->slots_[tail % ring->slots_.size()];
+      batch->Clear();
+      std::string_view text = raw.text;
+      size_t line_index = raw.first_line;
+      for (size_t begin = 0; begin < text.size(); ++line_index) {
+        size_t end = std::min(text.find('\n', begin), text.size());
+        std::string_view line = text.substr(begin, end - begin);
+        if (line != "" && line != "\r") {
+          ParseEmnistLetter(line, letter.data());
+          batch->Add(line_index + 1, letter.data());
+        }
+        begin = end + 1;
+      }
+      TraceBatch(batch_begin);
+      ring->tail_.fetch_add(1, std::memory_order_release);
+    }
+  } catch (...) {
+    ring->error_ = std::current_exception();
+  }
+  return true;
+}
+
+//  Takes the next batch of reader, reading the file up to it if no other
+//  reader did; false once the file has no more batches for it
+bool DataLoader::Split_(size_t reader, RawBatch* raw) {
+  std::lock_guard<std::mutex> lock(input_mutex_);
+  Ring* ring = rings_[reader];
+  while (ring->raw_.empty() && !input_ended_) {
+    RawBatch batch;
+    batch.first_line = num_lines_;
+    try {
+      if (!input_) {
+        input_ = OpenInputStream(data_file_);
+      }
+      std::string line;
+      for (size_t i = 0; i < batch_size_ && std::getline(*input_, line);
+           ++i) {
+        batch.text += line;
+        batch.text += '\n';
+        ++num_lines_;
+      }
+      input_ended_ = input_->peek() == std::istream::traits_type::eof();
+    } catch (...) {
+      //  Raised by the reader of the batch, after those before it
+      batch.error = std::current_exception();
+      input_ended_ = true;
+    }
+    if (!batch.text.empty() || batch.error) {
+      rings_[num_split_ % rings_.size()]->raw_.push_back(std::move(batch));
+      ++num_split_;
+    }
+  }
+  if (ring->raw_.empty()) {
+    return false;
+  }
+  *raw = std::move(ring->raw_.front());
+  ring->raw_.pop_front();
+  return true;
+}
+
+}  // namespace s21
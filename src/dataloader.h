@@ -0,0 +1,134 @@
+#ifndef SRC_DATALOADER_H_
+#define SRC_DATALOADER_H_
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dataset.h"
+#include "network.h"
+#include "threadpool.h"
+
+namespace s21 {
+
+const size_t kLoaderQueueDepth = 2;
+
+//  Decoded samples of one batch, in the DataSet layout
+
+class SampleBatch : public DataSet {
+ public:
+  SampleBatch() {}
+
+  size_t GetSize() const override { return indices_.size(); }
+  int GetLabel(size_t index) const override {
+    return records_[index * kRecordSize];
+  }
+  const uint8_t* GetImage(size_t index) const override {
+    return records_.data() + index * kRecordSize + 1;
+  }
+  //  1-based line number of the sample in the source file
+  size_t GetIndex(size_t index) const { return indices_[index]; }
+  const uint8_t* GetRecords() const { return records_.data(); }
+
+  void Clear();
+  void Add(size_t line_index, const int* letter);
+
+ private:
+  static const size_t kRecordSize = kInputLayerNeurons + 1;
+
+  std::vector<uint8_t> records_;
+  std::vector<size_t> indices_;
+};
+
+struct LoaderStats {
+  size_t batches;
+  size_t queue_depth;
+  size_t producer_stalls;
+  size_t consumer_stalls;
+  double producer_stall_time;
+  double consumer_stall_time;
+};
+
+//  Reads a CSV dataset ahead of the consumer. Reader r parses batches
+//  r, r + num_readers, ... into its own lock-free single-producer ring of
+//  queue_depth batches (double buffering by default), and Next() takes them
+//  round-robin, so batches come out in file order. The file is read once:
+//  a reader whose next batch isn't split yet splits the lines up to it
+//  under a lock and leaves the batches of the others with them, then
+//  parses its own outside the lock. Readers are pool tasks
+//  that return when their ring is full and are resubmitted when the
+//  consumer frees a slot, so they never hold a worker while blocked.
+//  Consumer stalls mean the run is I/O-bound, producer stalls mean it is
+//  compute-bound
+
+class DataLoader {
+ public:
+  explicit DataLoader(const std::string& data_file, size_t num_readers = 1,
+                      size_t queue_depth = kLoaderQueueDepth,
+                      size_t batch_size = kDataSetBatchSize,
+                      ThreadPool* pool = ThreadPool::GetDefault());
+  DataLoader(const DataLoader&) = delete;
+  DataLoader& operator=(const DataLoader&) = delete;
+  ~DataLoader();
+
+  //  Returns the next batch (the previous one is released) or nullptr at the
+  //  end of the file; rethrows a reader's parse error
+  const SampleBatch* Next();
+  LoaderStats GetStats() const;
+
+ private:
+  //  Lines of one batch, split but not parsed yet
+  struct RawBatch {
+    size_t first_line = 0;
+    std::string text;
+    std::exception_ptr error;
+  };
+
+  class Ring {
+   public:
+    explicit Ring(size_t depth) : slots_(depth) {}
+
+    std::vector<SampleBatch> slots_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::atomic<bool> done_{false};
+    std::exception_ptr error_;
+    std::atomic<size_t> stalls_{0};
+    std::atomic<size_t> stall_time_{0};
+    //  State of the reader between its tasks
+    std::atomic<bool> scheduled_{false};
+    uint64_t paused_at_ = 0;
+    //  Its batches split by any reader, under input_mutex_
+    std::deque<RawBatch> raw_;
+  };
+
+  std::string data_file_;
+  size_t batch_size_;
+  ThreadPool* pool_;
+  std::vector<Ring*> rings_;
+  TaskGroup readers_;
+  std::atomic<bool> stop_;
+  std::mutex input_mutex_;
+  std::unique_ptr<std::istream> input_;
+  size_t num_split_;
+  size_t num_lines_;
+  bool input_ended_;
+  size_t next_batch_;
+  bool has_current_;
+  size_t consumer_stalls_;
+  size_t consumer_stall_time_;
+
+  void Schedule_(size_t reader);
+  void Read_(size_t reader);
+  bool Fill_(size_t reader);
+  bool Split_(size_t reader, RawBatch* raw);
+};
+
+}  // namespace s21
+
+#endif  //  SRC_DATALOADER_H_
@@ -0,0 +1,268 @@
+#include "dataset.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "dataloader.h"
+#include "decompressor.h"
+#include "network.h"
+
+namespace s21 {
+
+MappedFile::MappedFile(const std::string& file_name)
+    : data_(MAP_FAILED), size_(0) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::invalid_argument("Error: can't open the " + file_name);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    throw std::invalid_argument("Error: incorrect format of " + file_name);
+  }
+  size_ = st.st_size;
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data_ == MAP_FAILED) {
+    throw std::invalid_argument("Error: can't map the " + file_name);
+  }
+  madvise(data_, size_, MADV_WILLNEED);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != MAP_FAILED) {
+    munmap(data_, size_);
+  }
+}
+
+BinaryDataSet::BinaryDataSet(const std::string& data_file)
+    : file_(data_file), records_(nullptr), num_samples_(0), record_size_(0) {
+  DataSetHeader header;
+  if (file_.GetSize() < sizeof(header)) {
+    throw std::invalid_argument("Error: incorrect format of " + data_file);
+  }
+  std::memcpy(&header, file_.GetData(), sizeof(header));
+  if (std::memcmp(header.magic, kDataSetMagic, sizeof(kDataSetMagic)) != 0 ||
+      header.version != kDataSetVersion ||
+      header.image_size != kInputLayerNeurons ||
+      header.record_size != kInputLayerNeurons + 1 ||
+      sizeof(header) +
+              static_cast<size_t>(header.num_samples) * header.record_size >
+          file_.GetSize()) {
+    throw std::invalid_argument("Error: incorrect format of " + data_file);
+  }
+  num_samples_ = header.num_samples;
+  record_size_ = header.record_size;
+  records_ = file_.GetData() + sizeof(header);
+  for (size_t i = 0; i < num_samples_; ++i) {
+    int label = records_[i * record_size_];
+    if (label < 1 || label > kOutputLayerNeurons) {
+      throw std::invalid_argument("Error: incorrect labels in " + data_file);
+    }
+  }
+}
+
+static uint32_t ReadBigEndian(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) << 24 |
+         static_cast<uint32_t>(data[1]) << 16 |
+         static_cast<uint32_t>(data[2]) << 8 | static_cast<uint32_t>(data[3]);
+}
+
+IdxDataSet::IdxDataSet(const std::string& images_file,
+                       const std::string& labels_file)
+    : images_file_(images_file),
+      labels_file_(labels_file),
+      images_(nullptr),
+      labels_(nullptr),
+      num_samples_(0) {
+  const uint8_t* images = images_file_.GetData();
+  const uint8_t* labels = labels_file_.GetData();
+  if (images_file_.GetSize() < 16 || ReadBigEndian(images) != kIdxImagesMagic ||
+      ReadBigEndian(images + 8) * ReadBigEndian(images + 12) != kImageSize) {
+    throw std::invalid_argument("Error: incorrect format of " + images_file);
+  }
+  if (labels_file_.GetSize() < 8 || ReadBigEndian(labels) != kIdxLabelsMagic) {
+    throw std::invalid_argument("Error: incorrect format of " + labels_file);
+  }
+  num_samples_ = ReadBigEndian(images + 4);
+  if (ReadBigEndian(labels + 4) != num_samples_ ||
+      16 + num_samples_ * kImageSize > images_file_.GetSize() ||
+      8 + num_samples_ > labels_file_.GetSize()) {
+    throw std::invalid_argument("Error: incorrect format of " + images_file);
+  }
+  images_ = images + 16;
+  labels_ = labels + 8;
+  for (size_t i = 0; i < num_samples_; ++i) {
+    if (labels_[i] < 1 || labels_[i] > kOutputLayerNeurons) {
+      throw std::invalid_argument("Error: incorrect labels in " + labels_file);
+    }
+  }
+}
+
+MemoryDataSet::MemoryDataSet(const DataSet& data)
+    : records_(data.GetSize() * kRecordSize), num_samples_(data.GetSize()) {
+  uint8_t* record = records_.data();
+  for (size_t i = 0; i < num_samples_; ++i, record += kRecordSize) {
+    record[0] = static_cast<uint8_t>(data.GetLabel(i));
+    std::memcpy(record + 1, data.GetImage(i), kInputLayerNeurons);
+  }
+}
+
+Fold MakeFold(const DataSet& data, size_t num_folds, size_t fold) {
+  if (num_folds < 2 || fold >= num_folds) {
+    throw std::out_of_range("Error: incorrect fold");
+  }
+  size_t size = data.GetSize();
+  size_t begin = fold * size / num_folds;
+  size_t end = (fold + 1) * size / num_folds;
+  std::vector<size_t> train(size - (end - begin));
+  std::vector<size_t> validation(end - begin);
+  std::iota(train.begin(), train.begin() + begin, 0);
+  std::iota(train.begin() + begin, train.end(), end);
+  std::iota(validation.begin(), validation.end(), begin);
+  return Fold{DataSetView(data, std::move(train)),
+              DataSetView(data, std::move(validation))};
+}
+
+std::vector<size_t> ShuffleIndices(size_t size, uint32_t seed) {
+  std::vector<size_t> indices(size);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::mt19937 rng(seed);
+  std::shuffle(indices.begin(), indices.end(), rng);
+  return indices;
+}
+
+void ParseEmnistLetter(std::string_view line, int* letter) {
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  const char* first = line.data();
+  const char* last = first + line.size();
+  const char* it = first;
+  int i = 0;
+  for (;; ++i) {
+    if (i == kInputLayerNeurons + 1) {
+      throw std::length_error(
+          "Error, incorrect dataset format: too many values at position " +
+          std::to_string(it - first));
+    }
+    //  Pixels have at most 3 digits, longer values go through from_chars
+    const char* ptr = it;
+    int value = 0;
+    while (ptr != last && ptr - it < 3 &&
+           static_cast<unsigned>(*ptr - '0') < 10) {
+      value = value * 10 + (*ptr++ - '0');
+    }
+    if (ptr != last && *ptr != ',') {
+      auto result = std::from_chars(it, last, value);
+      if (result.ec != std::errc()) {
+        throw std::invalid_argument(
+            "Error, incorrect dataset format at position " +
+            std::to_string(it - first));
+      }
+      ptr = result.ptr;
+    } else if (ptr == it) {
+      throw std::invalid_argument(
+          "Error, incorrect dataset format at position " +
+          std::to_string(it - first));
+    }
+    letter[i] = value;
+    if (ptr == last) {
+      break;
+    }
+    if (*ptr != ',') {
+      throw std::invalid_argument(
+          "Error, incorrect dataset format at position " +
+          std::to_string(ptr - first));
+    }
+    it = ptr + 1;
+  }
+  if (i != kInputLayerNeurons) {
+    throw std::length_error(
+        "Error, incorrect dataset format: " + std::to_string(i + 1) +
+        " values instead of " + std::to_string(kInputLayerNeurons + 1));
+  }
+}
+
+size_t ConvertDataSet(const std::string& csv_file,
+                      const std::string& bin_file) {
+  DataLoader loader(csv_file,
+                    std::max(1u, std::thread::hardware_concurrency()));
+  std::string tmp_file = bin_file + ".tmp";
+  std::ofstream out(tmp_file, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::invalid_argument("Error: can't save the " + bin_file);
+  }
+
+  DataSetHeader header{};
+  std::memcpy(header.magic, kDataSetMagic, sizeof(kDataSetMagic));
+  header.version = kDataSetVersion;
+  header.record_size = kInputLayerNeurons + 1;
+  header.image_size = kInputLayerNeurons;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  size_t num_samples = 0;
+  try {
+    while (const SampleBatch* batch = loader.Next()) {
+      out.write(reinterpret_cast<const char*>(batch->GetRecords()),
+                batch->GetSize() * header.record_size);
+      num_samples += batch->GetSize();
+    }
+  } catch (const std::exception& e) {
+    out.close();
+    std::remove(tmp_file.c_str());
+    throw;
+  }
+
+  header.num_samples = static_cast<uint32_t>(num_samples);
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.close();
+  if (!out || std::rename(tmp_file.c_str(), bin_file.c_str()) != 0) {
+    std::remove(tmp_file.c_str());
+    throw std::invalid_argument("Error: can't save the " + bin_file);
+  }
+  return num_samples;
+}
+
+std::unique_ptr<DataSet> OpenDataSet(const std::string& data_file) {
+  namespace fs = std::filesystem;
+  fs::path path(data_file);
+  if (path.extension() == kDataSetCacheExtension) {
+    return std::make_unique<BinaryDataSet>(data_file);
+  }
+  size_t pos = data_file.rfind(kIdxImagesSuffix);
+  if (pos != std::string::npos) {
+    std::string labels_file = data_file;
+    labels_file.replace(pos, kIdxImagesSuffix.size(), kIdxLabelsSuffix);
+    return std::make_unique<IdxDataSet>(data_file, labels_file);
+  }
+  std::string cache_file = fs::path(StripCompressionExtension(data_file))
+                               .replace_extension(kDataSetCacheExtension)
+                               .string();
+  std::error_code ec;
+  if (!fs::exists(cache_file, ec) ||
+      fs::last_write_time(cache_file, ec) < fs::last_write_time(path, ec)) {
+    ConvertDataSet(data_file, cache_file);
+  }
+  return std::make_unique<BinaryDataSet>(cache_file);
+}
+
+std::unique_ptr<DataSet> LoadDataSet(const std::string& data_file) {
+  return std::make_unique<MemoryDataSet>(*OpenDataSet(data_file));
+}
+
+}  // namespace s21
@@ -0,0 +1,180 @@
+#ifndef SRC_DATASET_H_
+#define SRC_DATASET_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace s21 {
+
+//  Binary dataset cache: a fixed-size header followed by records of one
+//  label byte and kInputLayerNeurons pixel bytes each (fixed stride)
+
+const char kDataSetMagic[4] = {'M', 'L', 'P', 'D'};
+const uint32_t kDataSetVersion = 1;
+const std::string kDataSetCacheExtension = ".bin";
+const uint32_t kShuffleSeed = 21;
+
+struct DataSetHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_samples;
+  uint32_t record_size;
+  uint32_t image_size;
+  uint32_t reserved[3];
+};
+
+//  EMNIST IDX files (big-endian header, then raw unsigned bytes)
+
+const uint32_t kIdxImagesMagic = 0x00000803;
+const uint32_t kIdxLabelsMagic = 0x00000801;
+const std::string kIdxImagesSuffix = "-images-idx3-ubyte";
+const std::string kIdxLabelsSuffix = "-labels-idx1-ubyte";
+
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& file_name);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  const uint8_t* GetData() const { return static_cast<const uint8_t*>(data_); }
+  size_t GetSize() const { return size_; }
+
+ private:
+  void* data_;
+  size_t size_;
+};
+
+//  Read-only view of EMNIST samples: labels are 1-based letters,
+//  images are kInputLayerNeurons bytes in the EMNIST pixel order
+
+class DataSet {
+ public:
+  virtual ~DataSet() {}
+
+  virtual size_t GetSize() const = 0;
+  virtual int GetLabel(size_t index) const = 0;
+  virtual const uint8_t* GetImage(size_t index) const = 0;
+};
+
+class BinaryDataSet : public DataSet {
+ public:
+  explicit BinaryDataSet(const std::string& data_file);
+
+  size_t GetSize() const override { return num_samples_; }
+  int GetLabel(size_t index) const override {
+    return records_[index * record_size_];
+  }
+  const uint8_t* GetImage(size_t index) const override {
+    return records_ + index * record_size_ + 1;
+  }
+
+ private:
+  MappedFile file_;
+  const uint8_t* records_;
+  size_t num_samples_;
+  size_t record_size_;
+};
+
+//  Reads the official EMNIST distribution directly. Its images are stored
+//  transposed (column by column) and its letter labels are 1-based, which is
+//  exactly the layout of the EMNIST CSV the networks are trained on, so the
+//  mapped bytes are used as they are
+
+class IdxDataSet : public DataSet {
+ public:
+  IdxDataSet(const std::string& images_file, const std::string& labels_file);
+
+  size_t GetSize() const override { return num_samples_; }
+  int GetLabel(size_t index) const override { return labels_[index]; }
+  const uint8_t* GetImage(size_t index) const override {
+    return images_ + index * kImageSize;
+  }
+
+ private:
+  static const size_t kImageSize = 784;
+
+  MappedFile images_file_;
+  MappedFile labels_file_;
+  const uint8_t* images_;
+  const uint8_t* labels_;
+  size_t num_samples_;
+};
+
+//  Resident copy of a dataset in one compact array (fixed stride records)
+
+class MemoryDataSet : public DataSet {
+ public:
+  explicit MemoryDataSet(const DataSet& data);
+
+  size_t GetSize() const override { return num_samples_; }
+  int GetLabel(size_t index) const override {
+    return records_[index * kRecordSize];
+  }
+  const uint8_t* GetImage(size_t index) const override {
+    return records_.data() + index * kRecordSize + 1;
+  }
+
+ private:
+  static const size_t kRecordSize = 785;
+
+  std::vector<uint8_t> records_;
+  size_t num_samples_;
+};
+
+//  Samples of another dataset in the given order, nothing is copied
+
+class DataSetView : public DataSet {
+ public:
+  DataSetView(const DataSet& data, std::vector<size_t> indices)
+      : data_(data), indices_(std::move(indices)) {}
+
+  size_t GetSize() const override { return indices_.size(); }
+  int GetLabel(size_t index) const override {
+    return data_.GetLabel(indices_[index]);
+  }
+  const uint8_t* GetImage(size_t index) const override {
+    return data_.GetImage(indices_[index]);
+  }
+  const std::vector<size_t>& GetIndices() const { return indices_; }
+
+ private:
+  const DataSet& data_;
+  std::vector<size_t> indices_;
+};
+
+//  Fold `fold` (0-based) of num_folds contiguous folds: the held-out samples
+//  and the rest, both as views into data
+
+struct Fold {
+  DataSetView train;
+  DataSetView validation;
+};
+
+Fold MakeFold(const DataSet& data, size_t num_folds, size_t fold);
+
+//  Permutation of 0..size-1 from std::mt19937 seeded with seed, so an epoch
+//  is reproducible from (seed, epoch)
+std::vector<size_t> ShuffleIndices(size_t size, uint32_t seed);
+
+//  Parses one CSV line of kInputLayerNeurons + 1 values into letter[], throws
+//  std::invalid_argument/std::length_error with the error position in the line
+void ParseEmnistLetter(std::string_view line, int* letter);
+
+//  Converts a CSV dataset to the binary format, returns the number of samples
+size_t ConvertDataSet(const std::string& csv_file, const std::string& bin_file);
+
+//  Opens a binary or IDX (*-images-idx3-ubyte) dataset; a CSV file (plain,
+//  .gz or .zst) is converted once to a cache file next to it (re-converted
+//  when the CSV is newer than the cache)
+std::unique_ptr<DataSet> OpenDataSet(const std::string& data_file);
+
+//  Opens a dataset like OpenDataSet and loads it into memory
+std::unique_ptr<DataSet> LoadDataSet(const std::string& data_file);
+
+}  // namespace s21
+
+#endif  //  SRC_DATASET_H_
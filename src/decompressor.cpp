@@ -0,0 +1,225 @@
+#include "decompressor.h"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include "tracer.h"
+
+#ifdef MLP_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace s21 {
+
+static bool EndsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+DecompressBuffer::DecompressBuffer(const std::string& file_name)
+    : file_name_(file_name),
+      chunks_(kDecompressChunks),
+      current_(nullptr),
+      done_(false),
+      stop_(false) {
+  if (!std::ifstream(file_name_).is_open()) {
+    throw std::invalid_argument("Error: can't open the " + file_name_);
+  }
+#ifndef MLP_WITH_ZSTD
+  if (EndsWith(file_name_, kZstdExtension)) {
+    throw std::invalid_argument(
+        "Error: built without zstd support, can't read " + file_name_);
+  }
+#endif
+  for (auto& it : chunks_) {
+    it.data.resize(kDecompressChunkSize);
+    free_.push_back(&it);
+  }
+  thread_ = std::thread([this] {
+    Tracer::GetInstance().SetThreadName("decompress");
+    try {
+      if (EndsWith(file_name_, kZstdExtension)) {
+        DecompressZstd_();
+      } else {
+        DecompressGzip_();
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    cv_.notify_all();
+  });
+}
+
+DecompressBuffer::~DecompressBuffer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+DecompressBuffer::int_type DecompressBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (current_) {
+    free_.push_back(current_);
+    current_ = nullptr;
+    cv_.notify_all();
+  }
+  cv_.wait(lock, [this] { return !ready_.empty() || done_; });
+  if (ready_.empty()) {
+    setg(nullptr, nullptr, nullptr);
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return traits_type::eof();
+  }
+  current_ = ready_.front();
+  ready_.pop_front();
+  char* data = current_->data.data();
+  setg(data, data, data + current_->size);
+  return traits_type::to_int_type(*gptr());
+}
+
+DecompressBuffer::Chunk* DecompressBuffer::AcquireFree_() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return !free_.empty() || stop_; });
+  if (stop_) {
+    return nullptr;
+  }
+  Chunk* chunk = free_.front();
+  free_.pop_front();
+  return chunk;
+}
+
+void DecompressBuffer::Publish_(Chunk* chunk) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ready_.push_back(chunk);
+  cv_.notify_all();
+}
+
+void DecompressBuffer::DecompressGzip_() {
+  gzFile fp = gzopen(file_name_.c_str(), "rb");
+  if (!fp) {
+    throw std::invalid_argument("Error: can't open the " + file_name_);
+  }
+  gzbuffer(fp, 1 << 17);
+  bool ended = false;
+  for (Chunk* chunk = AcquireFree_(); chunk; chunk = AcquireFree_()) {
+    MLP_TRACE_SPAN("decompress");
+    int size = gzread(fp, chunk->data.data(),
+                      static_cast<unsigned>(chunk->data.size()));
+    if (size <= 0) {
+      ended = true;
+      break;
+    }
+    chunk->size = size;
+    Publish_(chunk);
+  }
+  //  A cut stream ends like a whole one, only gzerror (Z_BUF_ERROR) or
+  //  gzclose tell them apart
+  int code = Z_OK;
+  std::string message = ended ? gzerror(fp, &code) : "";
+  int closed = gzclose(fp);
+  if (ended && (code != Z_OK || closed != Z_OK)) {
+    throw std::runtime_error("Error: can't decompress the " + file_name_ +
+                             ": " +
+                             (code != Z_OK ? message : zError(closed)));
+  }
+}
+
+void DecompressBuffer::DecompressZstd_() {
+#ifdef MLP_WITH_ZSTD
+  std::unique_ptr<FILE, int (*)(FILE*)> fp(std::fopen(file_name_.c_str(), "rb"),
+                                           &std::fclose);
+  std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> stream(
+      ZSTD_createDStream(), &ZSTD_freeDStream);
+  if (!fp || !stream) {
+    throw std::invalid_argument("Error: can't open the " + file_name_);
+  }
+  ZSTD_initDStream(stream.get());
+  std::vector<char> in_data(ZSTD_DStreamInSize());
+  ZSTD_inBuffer input{in_data.data(), 0, 0};
+  bool eof = false;
+  //  Nonzero while a frame still needs input. Only calls that make progress
+  //  count: past the end of a frame the hint is already for the next one
+  size_t remaining = 0;
+  for (Chunk* chunk = AcquireFree_(); chunk; chunk = AcquireFree_()) {
+    MLP_TRACE_SPAN("decompress");
+    ZSTD_outBuffer output{chunk->data.data(), chunk->data.size(), 0};
+    while (output.pos < output.size) {
+      if (input.pos == input.size && !eof) {
+        input.size = std::fread(in_data.data(), 1, in_data.size(), fp.get());
+        input.pos = 0;
+        eof = input.size == 0;
+      }
+      size_t pos = output.pos;
+      size_t in_pos = input.pos;
+      size_t result = ZSTD_decompressStream(stream.get(), &output, &input);
+      if (ZSTD_isError(result)) {
+        throw std::runtime_error("Error: can't decompress the " + file_name_ +
+                                 ": " + ZSTD_getErrorName(result));
+      }
+      if (output.pos != pos || input.pos != in_pos) {
+        remaining = result;
+      }
+      if (eof && output.pos == pos) {
+        if (remaining != 0) {
+          throw std::runtime_error("Error: can't decompress the " +
+                                   file_name_ + ": truncated frame");
+        }
+        break;
+      }
+    }
+    if (output.pos == 0) {
+      break;
+    }
+    chunk->size = output.pos;
+    Publish_(chunk);
+  }
+#endif
+}
+
+DecompressStream::DecompressStream(const std::string& file_name)
+    : std::istream(nullptr), buffer_(file_name) {
+  rdbuf(&buffer_);
+  //  Lets a decompression error reach the reader instead of a silent eof
+  exceptions(std::ios::badbit);
+}
+
+bool IsCompressedFile(const std::string& file_name) {
+  return EndsWith(file_name, kGzipExtension) ||
+         EndsWith(file_name, kZstdExtension);
+}
+
+std::string StripCompressionExtension(const std::string& file_name) {
+  if (EndsWith(file_name, kGzipExtension)) {
+    return file_name.substr(0, file_name.size() - kGzipExtension.size());
+  }
+  if (EndsWith(file_name, kZstdExtension)) {
+    return file_name.substr(0, file_name.size() - kZstdExtension.size());
+  }
+  return file_name;
+}
+
+std::unique_ptr<std::istream> OpenInputStream(const std::string& file_name) {
+  if (IsCompressedFile(file_name)) {
+    return std::make_unique<DecompressStream>(file_name);
+  }
+  auto fp = std::make_unique<std::ifstream>(file_name);
+  if (!fp->is_open()) {
+    throw std::invalid_argument("Error: can't open the " + file_name);
+  }
+  return fp;
+}
+
+}  // namespace s21
@@ -0,0 +1,78 @@
+#ifndef SRC_DECOMPRESSOR_H_
+#define SRC_DECOMPRESSOR_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace s21 {
+
+const std::string kGzipExtension = ".gz";
+const std::string kZstdExtension = ".zst";
+
+const size_t kDecompressChunkSize = 1 << 20;
+const size_t kDecompressChunks = 4;
+
+//  Stream buffer over a .gz (zlib) or .zst (zstd, built with MLP_WITH_ZSTD)
+//  file. A background thread decompresses ahead into a few fixed chunks, so
+//  decompression overlaps with whoever reads the stream
+
+class DecompressBuffer : public std::streambuf {
+ public:
+  explicit DecompressBuffer(const std::string& file_name);
+  DecompressBuffer(const DecompressBuffer&) = delete;
+  DecompressBuffer& operator=(const DecompressBuffer&) = delete;
+  ~DecompressBuffer();
+
+ protected:
+  int_type underflow() override;
+
+ private:
+  struct Chunk {
+    std::vector<char> data;
+    size_t size;
+  };
+
+  std::string file_name_;
+  std::vector<Chunk> chunks_;
+  std::deque<Chunk*> free_;
+  std::deque<Chunk*> ready_;
+  Chunk* current_;
+  bool done_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+
+  Chunk* AcquireFree_();
+  void Publish_(Chunk* chunk);
+  void DecompressGzip_();
+  void DecompressZstd_();
+};
+
+class DecompressStream : public std::istream {
+ public:
+  explicit DecompressStream(const std::string& file_name);
+
+ private:
+  DecompressBuffer buffer_;
+};
+
+bool IsCompressedFile(const std::string& file_name);
+
+//  File name without the compression extension
+std::string StripCompressionExtension(const std::string& file_name);
+
+//  Opens a plain or compressed file for reading
+std::unique_ptr<std::istream> OpenInputStream(const std::string& file_name);
+
+}  // namespace s21
+
+#endif  //  SRC_DECOMPRESSOR_H_
@@ -1,16 +1,33 @@
 #include "drawdialog.h"
 
+#include "controller.h"
 #include "ui_drawdialog.h"
 
 DrawDialog::DrawDialog(QWidget *parent)
     : QDialog(parent),
       ui(new Ui::DrawDialog),
-      image_(new QImage(512, 512, QImage::Format_RGB16)) {
+      image_(new QImage(512, 512, QImage::Format_RGB16)),
+      live_timer_(new QTimer(this)) {
   ui->setupUi(this);
   image_->fill(Qt::white);
+  live_timer_->setSingleShot(true);
+  connect(live_timer_, &QTimer::timeout, this, &DrawDialog::SubmitLive_);
+  //  The dialog is modal and opened only without a running job, so the
+  //  current network isn't trained or loaded meanwhile
+  live_ = std::make_unique<s21::LivePredictor>(
+      [](const uint8_t *images, size_t count, double *outputs) {
+        s21::Controller::GetInstance()->PredictBatch(images, count, outputs);
+      },
+      [this](const s21::LivePrediction &result) {
+        QMetaObject::invokeMethod(
+            this, [this, result] { ShowLive_(result); },
+            Qt::QueuedConnection);
+      });
 }
 
 DrawDialog::~DrawDialog() {
+  //  Stopped first, so no result is posted to a dialog going away
+  live_.reset();
   delete ui;
   delete image_;
 }
@@ -38,8 +55,14 @@ void DrawDialog::mouseMoveEvent(QMouseEvent *event) {
     QPoint point = event->pos();
     painter.drawLine(current_point_.x(), current_point_.y(), point.x(),
                      point.y());
+    //  Only the new segment is repainted
+    update(QRect(current_point_, point)
+               .normalized()
+               .adjusted(-kWidth, -kWidth, kWidth, kWidth));
     current_point_ = point;
-    update();
+    if (!live_timer_->isActive()) {
+      live_timer_->start(kLiveIntervalMs);
+    }
   }
 }
 
@@ -52,4 +75,38 @@ void DrawDialog::mouseReleaseEvent(QMouseEvent *event) {
 void DrawDialog::on_pushButtonClear_clicked() {
   image_->fill(Qt::white);
   update();
+  live_timer_->stop();
+  live_->Cancel();
+  live_cleared_ = live_submitted_;
+  ui->labelLive->clear();
+}
+
+void DrawDialog::SubmitLive_() {
+  //  A shallow copy, the conversion runs on the predictor thread
+  QImage image = *image_;
+  live_submitted_ = live_->Submit([image] {
+    //  Format_RGB32 is 0xffRRGGBB words, BGRA bytes on little-endian hosts
+    QImage pixels = image.convertToFormat(QImage::Format_RGB32);
+    return s21::ToInkImage(pixels.constBits(), pixels.width(),
+                           pixels.height(), pixels.bytesPerLine(),
+                           s21::kBgra32);
+  });
+}
+
+void DrawDialog::ShowLive_(const s21::LivePrediction &result) {
+  if (result.sequence <= live_cleared_) {
+    return;
+  }
+  if (!result.error.empty()) {
+    ui->labelLive->setText(QString::fromStdString(result.error));
+    return;
+  }
+  QString text;
+  for (int i = 0; i < s21::kTopLetters; ++i) {
+    text += QString("%1 %2%   ")
+                .arg(QChar('A' + result.letters[i]))
+                .arg(result.outputs[i] * 100, 0, 'f', 0);
+  }
+  ui->labelLive->setText(
+      text + QString("%1 ms").arg(result.latency_us / 1000, 0, 'f', 1));
 }
@@ -5,6 +5,10 @@
 #include <QImage>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QTimer>
+#include <memory>
+
+#include "livepredictor.h"
 
 namespace Ui {
 class DrawDialog;
@@ -30,10 +34,22 @@ class DrawDialog : public QDialog {
  private:
   const int kSize = 512;
   const int kWidth = 70;
+  //  Shortest time between two live predictions, about one frame
+  const int kLiveIntervalMs = 16;
   Ui::DrawDialog* ui;
   QImage* image_;
   bool begin_draw_ = false;
   QPoint current_point_;
+  //  Live prediction while drawing: moves start the timer, its timeout
+  //  hands a copy of the image to the predictor, results newer than the
+  //  last clear are shown
+  QTimer* live_timer_;
+  std::unique_ptr<s21::LivePredictor> live_;
+  uint64_t live_submitted_ = 0;
+  uint64_t live_cleared_ = 0;
+
+  void SubmitLive_();
+  void ShowLive_(const s21::LivePrediction& result);
 };
 
 #endif  //  SRC_DRAWDIALOG_H_
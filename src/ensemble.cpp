@@ -0,0 +1,141 @@
+#include "ensemble.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "tracer.h"
+
+namespace s21 {
+
+Ensemble::Ensemble(std::vector<std::shared_ptr<const WeightSnapshot>> models,
+                   ensemble_mode mode)
+    : models_(std::move(models)), mode_(mode) {
+  if (models_.empty() ||
+      std::find(models_.begin(), models_.end(), nullptr) != models_.end()) {
+    throw std::invalid_argument("Error: an ensemble needs models");
+  }
+  size_t width = models_.size() * kHiddenLayerNeurons;
+  first_layer_.resize(kInputLayerNeurons * width);
+  for (size_t m = 0; m < models_.size(); ++m) {
+    const double* weights = models_[m]->GetWeights().data();
+    for (int k = 0; k < kInputLayerNeurons; ++k) {
+      std::copy(weights + k * kHiddenLayerNeurons,
+                weights + (k + 1) * kHiddenLayerNeurons,
+                first_layer_.begin() + k * width + m * kHiddenLayerNeurons);
+    }
+  }
+}
+
+void Ensemble::Forward(const uint8_t* images, size_t count,
+                       double* outputs) const {
+  size_t num_models = models_.size();
+  int width = num_models * kHiddenLayerNeurons;
+  std::vector<double> inputs(count * kInputLayerNeurons);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    inputs[i] = static_cast<double>(images[i]) / 255.0;
+  }
+  std::vector<double> first(count * width);
+  DenseSigmoid(inputs.data(), count, kInputLayerNeurons, first_layer_.data(),
+               width, width, first.data());
+
+  std::vector<double> input(count * kHiddenLayerNeurons);
+  std::vector<double> output(count * kHiddenLayerNeurons);
+  std::vector<double> model_outputs(count * num_models * kOutputLayerNeurons);
+  for (size_t m = 0; m < num_models; ++m) {
+    for (size_t i = 0; i < count; ++i) {
+      auto row = first.begin() + i * width + m * kHiddenLayerNeurons;
+      std::copy(row, row + kHiddenLayerNeurons,
+                input.begin() + i * kHiddenLayerNeurons);
+    }
+    const WeightSnapshot& model = *models_[m];
+    const double* weights = model.GetWeights().data() +
+                            kInputLayerNeurons * kHiddenLayerNeurons;
+    for (size_t layer = 1; layer < model.GetNumLayers(); ++layer) {
+      int cols = layer + 1 == model.GetNumLayers() ? kOutputLayerNeurons
+                                                   : kHiddenLayerNeurons;
+      DenseSigmoid(input.data(), count, kHiddenLayerNeurons, weights, cols,
+                   cols, output.data());
+      weights += kHiddenLayerNeurons * cols;
+      std::swap(input, output);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      auto row = input.begin() + i * kOutputLayerNeurons;
+      std::copy(row, row + kOutputLayerNeurons,
+                model_outputs.begin() + (i * num_models + m) *
+                                            kOutputLayerNeurons);
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    Combine_(model_outputs.data() + i * num_models * kOutputLayerNeurons,
+             outputs + i * kOutputLayerNeurons);
+  }
+}
+
+int Ensemble::Predict(const std::vector<int>& input_layer) const {
+  if (input_layer.size() != kInputLayerNeurons) {
+    throw std::out_of_range("Error: incorrect size of the input layer");
+  }
+  uint8_t image[kInputLayerNeurons];
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    image[i] = std::clamp(input_layer[i], 0, 255);
+  }
+  std::vector<double> model_outputs(models_.size() * kOutputLayerNeurons);
+  ThreadPool::GetDefault()->ParallelFor(
+      0, models_.size(), 1, [&](size_t first, size_t last) {
+        static thread_local InferenceWorkspace workspace;
+        for (size_t m = first; m < last; ++m) {
+          models_[m]->Forward(image,
+                              model_outputs.data() + m * kOutputLayerNeurons,
+                              &workspace);
+        }
+      });
+  double outputs[kOutputLayerNeurons];
+  Combine_(model_outputs.data(), outputs);
+  return std::max_element(outputs, outputs + kOutputLayerNeurons) - outputs;
+}
+
+void Ensemble::PredictBatch(const uint8_t* images, size_t count,
+                            double* outputs) const {
+  MLP_TRACE_SPAN("predict ensemble");
+  ThreadPool::GetDefault()->ParallelFor(
+      0, count, kPredictGrain, [&](size_t first, size_t last) {
+        Forward(images + first * kInputLayerNeurons, last - first,
+                outputs + first * kOutputLayerNeurons);
+      });
+}
+
+ConfusionCounts Ensemble::Test(const DataSet& data, size_t max_tests) const {
+  MLP_TRACE_SPAN("test ensemble");
+  return TestBatches(
+      data, max_tests,
+      [this](const uint8_t* images, size_t count, double* outputs) {
+        Forward(images, count, outputs);
+      });
+}
+
+void Ensemble::Combine_(const double* model_outputs, double* outputs) const {
+  size_t num_models = models_.size();
+  std::fill(outputs, outputs + kOutputLayerNeurons, 0.0);
+  for (size_t m = 0; m < num_models; ++m) {
+    for (int j = 0; j < kOutputLayerNeurons; ++j) {
+      outputs[j] += model_outputs[m * kOutputLayerNeurons + j];
+    }
+  }
+  for (int j = 0; j < kOutputLayerNeurons; ++j) {
+    outputs[j] /= num_models;
+  }
+  if (mode_ == kMajorityVote) {
+    double votes[kOutputLayerNeurons] = {};
+    for (size_t m = 0; m < num_models; ++m) {
+      const double* output = model_outputs + m * kOutputLayerNeurons;
+      ++votes[std::max_element(output, output + kOutputLayerNeurons) -
+              output];
+    }
+    for (int j = 0; j < kOutputLayerNeurons; ++j) {
+      outputs[j] = (votes[j] + outputs[j]) / (num_models + 1);
+    }
+  }
+}
+
+}  // namespace s21
@@ -0,0 +1,52 @@
+#ifndef SRC_ENSEMBLE_H_
+#define SRC_ENSEMBLE_H_
+
+#include <memory>
+#include <vector>
+
+#include "snapshot.h"
+
+namespace s21 {
+
+typedef enum { kMeanProbability, kMajorityVote } ensemble_mode;
+
+//  Several models answering as one. The output layer is the mean of the
+//  model outputs, or for a vote (votes + mean) / (models + 1) per letter,
+//  so the majority wins and the mean breaks ties. The first layers of all
+//  models are stacked side by side into one kInputLayerNeurons x (models *
+//  kHiddenLayerNeurons) matrix, which makes the largest layer one batched
+//  GEMM for all of them. Immutable, safe to use from any number of threads
+class Ensemble {
+ public:
+  Ensemble(std::vector<std::shared_ptr<const WeightSnapshot>> models,
+           ensemble_mode mode = kMeanProbability);
+
+  size_t GetSize() const { return models_.size(); }
+  ensemble_mode GetMode() const { return mode_; }
+
+  //  Output layers of count images on the calling thread, a row of the
+  //  stacked weights serves all images before the next
+  void Forward(const uint8_t* images, size_t count, double* outputs) const;
+  //  0-based letter of pixels 0..255. For latency the models run at once
+  //  on the default thread pool, each one over its own weights
+  int Predict(const std::vector<int>& input_layer) const;
+  //  Like Network::PredictBatch, tiles of kPredictGrain images run on the
+  //  default thread pool
+  void PredictBatch(const uint8_t* images, size_t count,
+                    double* outputs) const;
+  //  Like WeightSnapshot::Test
+  ConfusionCounts Test(const DataSet& data, size_t max_tests) const;
+
+ private:
+  std::vector<std::shared_ptr<const WeightSnapshot>> models_;
+  ensemble_mode mode_;
+  std::vector<double> first_layer_;
+
+  //  Combines the output layers of all models for one image, model_outputs
+  //  holds kOutputLayerNeurons values per model
+  void Combine_(const double* model_outputs, double* outputs) const;
+};
+
+}  // namespace s21
+
+#endif  //  SRC_ENSEMBLE_H_
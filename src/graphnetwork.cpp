@@ -93,52 +93,18 @@ void GraphNetwork::ShowNetwork() {
   }
 }
 
-bool GraphNetwork::TrainNetwork(std::ifstream& fp, size_t& count,
-                                size_t g_begin, size_t g_end) {
-  for (size_t max = count + kDataSetBatchSize; count < max && !fp.eof();
-       ++count) {
-    std::string line;
-    std::getline(fp, line);
-    if (line != "") {
-      if (count < g_begin || count > g_end) {
-        ReadEmnistLetter(line);
-        EmnistLetterToVector_();
-        CalculateVector_();
-        CalculateDeltaWeights_(emnist_letter_.front());
-        UpdateWeights_();
-      }
-    }
-  }
-  if (!fp.eof()) {
-    return true;
-  } else {
-    return false;
-  }
+void GraphNetwork::TrainLetter_() {
+  EmnistLetterToVector_();
+  CalculateVector_();
+  AddTrainResult_(vector_.data());
+  CalculateDeltaWeights_(emnist_letter_.front());
+  UpdateWeights_();
 }
 
-bool GraphNetwork::TestNetwork(std::ifstream& fp, size_t& count,
-                               size_t max_tests) {
-  for (size_t max = count + kDataSetBatchSize;
-       count < max && count <= max_tests && !fp.eof(); ++count) {
-    std::string line;
-    std::getline(fp, line);
-    if (line != "") {
-      ReadEmnistLetter(line);
-      EmnistLetterToVector_();
-      CalculateVector_();
-      int max = MaxElement_();
-      ++(*confusion_matrix_)(emnist_letter_.front() - 1, max);
-      if (emnist_letter_.front() != MaxElement_() + 1) {
-        ++count_errors_;
-      }
-    }
-  }
-  if (!fp.eof()) {
-    return true;
-  } else {
-    --count;
-    return false;
-  }
+void GraphNetwork::TestLetter_() {
+  EmnistLetterToVector_();
+  CalculateVector_();
+  AddTestResult_(vector_.data());
 }
 
 void GraphNetwork::EmnistLetterToVector_() {
@@ -149,6 +115,9 @@ void GraphNetwork::EmnistLetterToVector_() {
 }
 
 void GraphNetwork::CalculateVector_() {
+  MLP_PROFILE_PHASE(kPhaseForward);
+  MLP_TRACE_SPAN("forward");
+  MLP_PROFILE_CALL(ObserveWorkspace(vector_.capacity() * sizeof(double)));
   for (auto& it : layers_) {
     for (auto& it_n : it->GetNeurons()) {
       double sum = 0;
@@ -196,7 +165,39 @@ void GraphNetwork::LoadWeights(const std::string& weights_file) {
   }
 }
 
+void GraphNetwork::GetWeights(std::vector<double>* weights) {
+  weights->clear();
+  for (auto& it : layers_) {
+    std::vector<Neuron>& neurons = it->GetNeurons();
+    for (size_t i = 0; i < neurons[0].GetWeight().size(); ++i) {
+      for (auto& it_n : neurons) {
+        weights->push_back(it_n.GetWeight()[i]);
+      }
+    }
+  }
+}
+
+void GraphNetwork::SetWeights(size_t num_layers,
+                              const std::vector<double>& weights) {
+  if (weights.size() != CountWeights(num_layers)) {
+    throw std::invalid_argument("Error: incorrect number of weights");
+  }
+  if (num_layers != layers_.size()) {
+    GenerateNetwork(num_layers - 2);
+  }
+  const double* value = weights.data();
+  for (auto& it : layers_) {
+    std::vector<Neuron>& neurons = it->GetNeurons();
+    for (size_t i = 0; i < neurons[0].GetWeight().size(); ++i) {
+      for (auto& it_n : neurons) {
+        it_n.GetWeight()[i] = *value++;
+      }
+    }
+  }
+}
+
 void GraphNetwork::SaveWeights(const std::string& weights_file) {
+  MLP_TRACE_SPAN("save weights");
   std::ofstream fp(weights_file);
   if (fp.is_open()) {
     fp << "Network weights:" << std::endl;
@@ -211,6 +212,8 @@ void GraphNetwork::SaveWeights(const std::string& weights_file) {
 }
 
 void GraphNetwork::CalculateDeltaWeights_(size_t expected) {
+  MLP_PROFILE_PHASE(kPhaseBackward);
+  MLP_TRACE_SPAN("backward");
   for (auto rit = layers_.rbegin(); rit != layers_.rend(); rit++) {
     if ((*rit)->GetType() == kOutputLayer) {
       for (size_t i = 0; i < (*rit)->GetNeurons().size(); ++i) {
@@ -239,6 +242,8 @@ void GraphNetwork::CalculateDeltaWeights_(size_t expected) {
 }
 
 void GraphNetwork::UpdateWeights_() {
+  MLP_PROFILE_PHASE(kPhaseUpdate);
+  MLP_TRACE_SPAN("update");
   EmnistLetterToVector_();
 
   for (auto& it : layers_) {
@@ -256,29 +261,65 @@ void GraphNetwork::UpdateWeights_() {
   }
 }
 
-int GraphNetwork::Predict(const std::vector<int>& input_layer) {
-  vector_.clear();
-  for (auto& it : input_layer) {
-    vector_.push_back(static_cast<double>(it) / 255.0);
+void GraphNetwork::Forward(const uint8_t* image, double* outputs,
+                           InferenceWorkspace* workspace) const {
+  std::vector<double>& input = workspace->input;
+  std::vector<double>& output = workspace->output;
+  input.resize(kInputLayerNeurons);
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    input[i] = static_cast<double>(image[i]) / 255.0;
   }
-  CalculateVector_();
-  int result = static_cast<int>(MaxElement_());
-  return result;
+  for (const Layer* it : layers_) {
+    const std::vector<Neuron>& neurons = it->GetNeurons();
+    output.resize(neurons.size());
+    for (size_t n = 0; n < neurons.size(); ++n) {
+      const std::vector<double>& weight = neurons[n].GetWeight();
+      double sum = 0;
+      for (size_t i = 0; i < weight.size(); ++i) {
+        sum += weight[i] * input[i];
+      }
+      output[n] = Sigmoid_(sum);
+    }
+    input.swap(output);
+  }
+  std::copy(input.begin(), input.begin() + kOutputLayerNeurons, outputs);
+}
+
+void GraphNetwork::PredictBatch(const uint8_t* images, size_t count,
+                                double* outputs) const {
+  ThreadPool::GetDefault()->ParallelFor(
+      0, count, kPredictGrain, [&](size_t first, size_t last) {
+        PredictRows_(images + first * kInputLayerNeurons, last - first,
+                     outputs + first * kOutputLayerNeurons);
+      });
 }
 
-int GraphNetwork::MaxElement_() {
-  if (vector_.empty()) {
-    throw std::out_of_range("Error: vector is empty");
+void GraphNetwork::PredictRows_(const uint8_t* images, size_t count,
+                                double* outputs) const {
+  size_t size = kInputLayerNeurons;
+  std::vector<double> input(count * size), output;
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = static_cast<double>(images[i]) / 255.0;
   }
-  int i = 0;
-  int result = 0;
-  for (auto& it : vector_) {
-    if (vector_[result] < it) {
-      result = i;
+  for (const Layer* it : layers_) {
+    const std::vector<Neuron>& neurons = it->GetNeurons();
+    output.assign(count * neurons.size(), 0);
+    //  Each neuron's weights are read once for the whole chunk
+    for (size_t n = 0; n < neurons.size(); ++n) {
+      const std::vector<double>& weight = neurons[n].GetWeight();
+      for (size_t i = 0; i < count; ++i) {
+        const double* value = &input[i * size];
+        double sum = 0;
+        for (size_t k = 0; k < weight.size(); ++k) {
+          sum += weight[k] * value[k];
+        }
+        output[i * neurons.size() + n] = Sigmoid_(sum);
+      }
     }
-    ++i;
+    size = neurons.size();
+    input.swap(output);
   }
-  return result;
+  std::copy(input.begin(), input.end(), outputs);
 }
 
 //  GraphNetwork::Layer
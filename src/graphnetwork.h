@@ -18,14 +18,17 @@ class GraphNetwork : public Network {
 
   void Clear();
 
-  bool TrainNetwork(std::ifstream& fp, size_t& count, size_t g_begin,
-                    size_t g_end) override;
-  bool TestNetwork(std::ifstream& fp, size_t& count, size_t max_tests) override;
-  int Predict(const std::vector<int>& input_layer) override;
+  void Forward(const uint8_t* image, double* outputs,
+               InferenceWorkspace* workspace) const override;
+  void PredictBatch(const uint8_t* images, size_t count,
+                    double* outputs) const override;
 
   std::vector<double>& GetVector() { return vector_; }
   void LoadWeights(const std::string& weights_file) override;
   void SaveWeights(const std::string& weights_file) override;
+  void GetWeights(std::vector<double>* weights) override;
+  void SetWeights(size_t num_layers,
+                  const std::vector<double>& weights) override;
   size_t GetNumLayers() override { return layers_.size(); }
 
   void GenerateNetwork(int num_hidden_layers) override;
@@ -58,6 +61,7 @@ class GraphNetwork : public Network {
     ~Layer() {}
     layer_type GetType() { return type_; }
     std::vector<s21::Neuron>& GetNeurons() { return neurons_; }
+    const std::vector<s21::Neuron>& GetNeurons() const { return neurons_; }
 
     void Load(std::ifstream* fp);
     void Save(std::ofstream* fp);
@@ -70,12 +74,18 @@ class GraphNetwork : public Network {
   std::vector<Layer*> layers_;
   std::vector<double> vector_{};
 
-  double Sigmoid_(double value) { return (1.0 / (1.0 + exp(-value))); }
-  int MaxElement_();
+ protected:
+  //  Training phases, protected so benchmarks can time them one by one
+  void TrainLetter_() override;
+  void TestLetter_() override;
+  double Sigmoid_(double value) const { return (1.0 / (1.0 + exp(-value))); }
   void EmnistLetterToVector_();
   void CalculateVector_();
   void CalculateDeltaWeights_(size_t expected);
   void UpdateWeights_();
+  //  PredictBatch of one chunk, with its own buffers
+  void PredictRows_(const uint8_t* images, size_t count,
+                    double* outputs) const;
 };
 
 }  // namespace s21
@@ -0,0 +1,114 @@
+#include "imagebatch.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>  // NOLINT(*)
+#include <filesystem>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "tracer.h"
+
+namespace s21 {
+
+static double MicrosecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+std::vector<std::string> ListImages(const std::string& dir) {
+  namespace fs = std::filesystem;
+  std::error_code error;
+  fs::directory_iterator it(dir, error);
+  if (error) {
+    throw std::invalid_argument("Error: can't open the " + dir);
+  }
+  std::vector<std::string> files;
+  for (; it != fs::directory_iterator(); it.increment(error)) {
+    std::string extension = it->path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (it->is_regular_file(error) && extension == ".bmp") {
+      files.push_back(it->path().string());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+static ImageResult DecodeImage(const std::string& file, uint8_t* input) {
+  ImageResult result;
+  result.file = file;
+  auto begin = std::chrono::steady_clock::now();
+  try {
+    PreprocessImage(LoadBmp(file), input);
+  } catch (const std::exception& e) {
+    result.error = e.what();
+  }
+  result.decode_us = MicrosecondsSince(begin);
+  return result;
+}
+
+ClassifyStats ClassifyImages(const std::vector<std::string>& files,
+                             const BatchForward& forward,
+                             const ImageSink& sink) {
+  MLP_TRACE_SPAN("classify images");
+  auto start = std::chrono::steady_clock::now();
+  ClassifyStats stats;
+  std::vector<ImageResult> results(kImageBatch);
+  std::vector<uint8_t> images(kImageBatch * kInputLayerNeurons);
+  std::vector<double> outputs(kImageBatch * kOutputLayerNeurons);
+  for (size_t first = 0; first < files.size(); first += kImageBatch) {
+    size_t count = std::min(kImageBatch, files.size() - first);
+    ThreadPool::GetDefault()->ParallelFor(
+        0, count, kDecodeGrain, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            results[i] = DecodeImage(files[first + i],
+                                     images.data() + i * kInputLayerNeurons);
+          }
+        });
+    //  Images read move up over the failed ones for one forward pass
+    size_t num_decoded = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (!results[i].error.empty()) {
+        continue;
+      }
+      if (num_decoded != i) {
+        std::copy(images.begin() + i * kInputLayerNeurons,
+                  images.begin() + (i + 1) * kInputLayerNeurons,
+                  images.begin() + num_decoded * kInputLayerNeurons);
+      }
+      ++num_decoded;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    if (num_decoded) {
+      forward(images.data(), num_decoded, outputs.data());
+    }
+    double predict_us = num_decoded ? MicrosecondsSince(begin) / num_decoded
+                                    : 0;
+
+    const double* output = outputs.data();
+    for (size_t i = 0; i < count; ++i) {
+      ImageResult& result = results[i];
+      if (result.error.empty()) {
+        const double* best =
+            std::max_element(output, output + kOutputLayerNeurons);
+        result.prediction = best - output;
+        result.confidence = *best;
+        result.predict_us = predict_us;
+        output += kOutputLayerNeurons;
+      } else {
+        ++stats.num_failed;
+      }
+      ++stats.num_images;
+      stats.decode_us += result.decode_us;
+      stats.predict_us += result.predict_us;
+      sink(result);
+    }
+  }
+  stats.seconds = MicrosecondsSince(start) / 1e6;
+  return stats;
+}
+
+}  // namespace s21
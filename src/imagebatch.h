@@ -0,0 +1,54 @@
+#ifndef SRC_IMAGEBATCH_H_
+#define SRC_IMAGEBATCH_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "preprocess.h"
+#include "snapshot.h"
+
+namespace s21 {
+
+//  Images decoded and then predicted together by ClassifyImages
+const size_t kImageBatch = 256;
+//  Images of one decode task on the thread pool
+const size_t kDecodeGrain = 4;
+
+struct ImageResult {
+  std::string file;
+  //  0-based letter and its output, -1 if the image couldn't be read
+  int prediction = -1;
+  double confidence = 0;
+  //  Load, decode and preprocess of this file, and its share of the
+  //  batched forward pass
+  double decode_us = 0;
+  double predict_us = 0;
+  std::string error;
+};
+
+struct ClassifyStats {
+  size_t num_images = 0;
+  size_t num_failed = 0;
+  double seconds = 0;
+  double decode_us = 0;
+  double predict_us = 0;
+};
+
+typedef std::function<void(const ImageResult& result)> ImageSink;
+
+//  .bmp files of a directory, not its subdirectories, sorted by name
+std::vector<std::string> ListImages(const std::string& dir);
+
+//  Classifies files kImageBatch at a time: the images are decoded and
+//  preprocessed in parallel on the default thread pool, then forward gives
+//  the output layers of all of them at once (e.g. Network::PredictBatch).
+//  sink gets every result on the calling thread in the order of files, an
+//  image that can't be read gets an error instead of stopping the rest
+ClassifyStats ClassifyImages(const std::vector<std::string>& files,
+                             const BatchForward& forward,
+                             const ImageSink& sink);
+
+}  // namespace s21
+
+#endif  //  SRC_IMAGEBATCH_H_
@@ -0,0 +1,276 @@
+#include "jobrunner.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "tracer.h"
+
+namespace s21 {
+
+JobRunner::~JobRunner() {
+  Cancel();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+template <typename Job>
+void JobRunner::Start_(Job job) {
+  CheckIdle_();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  error_ = nullptr;
+  cancel_ = false;
+  pass_ = kPassNone;
+  epoch_ = 0;
+  num_epochs_ = 0;
+  samples_ = 0;
+  total_ = 0;
+  errors_ = 0;
+  begin_ = Tracer::Now();
+  pass_begin_ = begin_.load();
+  end_ = 0;
+  state_ = kJobRunning;
+  thread_ = std::thread([this, job] {
+    Tracer::GetInstance().SetThreadName("job");
+    MLP_TRACE_SPAN("job");
+    try {
+      job();
+    } catch (...) {
+      //  Wait rethrows it once the thread is joined
+      error_ = std::current_exception();
+    }
+    end_ = Tracer::Now();
+    state_ = error_ ? kJobFailed : cancel_ ? kJobCancelled : kJobFinished;
+  });
+}
+
+void JobRunner::CheckIdle_() const {
+  if (IsRunning()) {
+    throw std::invalid_argument("Error: a job is already running");
+  }
+}
+
+void JobRunner::StartTraining(Network* network, const DataSet& train,
+                              const DataSet* test, int num_epochs,
+                              const CheckpointOptions& checkpoints) {
+  Checkpoint start;
+  start.seed = kShuffleSeed;
+  start.epoch = 1;
+  start.num_epochs = num_epochs;
+  start.cursor = 1;
+  Train_(network, train, test, start, checkpoints);
+}
+
+void JobRunner::ResumeTraining(Network* network, const DataSet& train,
+                               const DataSet* test,
+                               const Checkpoint& checkpoint,
+                               const CheckpointOptions& checkpoints) {
+  if (checkpoint.weights.empty()) {
+    throw std::invalid_argument("Error: the checkpoint has no weights");
+  }
+  Train_(network, train, test, checkpoint, checkpoints);
+}
+
+void JobRunner::Train_(Network* network, const DataSet& train,
+                       const DataSet* test, const Checkpoint& checkpoint,
+                       const CheckpointOptions& checkpoints) {
+  //  The network is set up on the calling thread, so that a snapshot is
+  //  published before the job counts as running
+  CheckIdle_();
+  if (checkpoint.weights.empty()) {
+    network->ResetTrainingCurve();
+  } else {
+    RestoreCheckpoint(checkpoint, network);
+  }
+  if (snapshots_) {
+    snapshots_->Publish(network);
+  }
+  Start_([this, network, &train, test, checkpoint, checkpoints,
+          snapshots = snapshots_, snapshot_batches = snapshot_batches_] {
+    Checkpoint state = checkpoint;
+    epochs_.clear();
+    const std::vector<TrainingPoint>& points =
+        network->GetTrainingCurve().GetEpochs();
+    for (size_t i = 0; i < points.size() && i < state.test_accuracy.size();
+         ++i) {
+      epochs_.push_back(EpochResult{static_cast<int>(i) + 1, points[i].loss,
+                                    points[i].accuracy,
+                                    state.test_accuracy[i], 0});
+    }
+    std::unique_ptr<CheckpointWriter> writer;
+    if (!checkpoints.file.empty()) {
+      writer = std::make_unique<CheckpointWriter>(checkpoints.file);
+    }
+    auto save = [&writer, &state, network] {
+      if (writer) {
+        TakeCheckpoint(network, &state);
+        writer->Write(state);
+      }
+    };
+    auto publish = [snapshots, network] {
+      if (snapshots) {
+        snapshots->Publish(network);
+      }
+    };
+    num_epochs_ = state.num_epochs;
+    size_t batches = 0;
+    while (state.epoch <= state.num_epochs) {
+      epoch_ = state.epoch;
+      uint64_t begin = Tracer::Now();
+      DataSetView epoch_data(
+          train, ShuffleIndices(train.GetSize(), state.seed + state.epoch));
+      StartPass_(kPassTrain, train.GetSize());
+      for (bool more = Update_(state.cursor - 1, 0); more;) {
+        more = network->TrainNetwork(epoch_data, state.cursor, 0, 0);
+        ++batches;
+        if (more && snapshot_batches && batches % snapshot_batches == 0) {
+          publish();
+        }
+        if (more && checkpoints.every_batches &&
+            batches % checkpoints.every_batches == 0) {
+          save();
+        }
+        if (!Update_(state.cursor - 1, 0)) {
+          break;
+        }
+      }
+      if (cancel_) {
+        save();
+        break;
+      }
+      network->FinishTrainingEpoch();
+      publish();
+      const TrainingPoint& point =
+          network->GetTrainingCurve().GetEpochs().back();
+      EpochResult result{state.epoch, point.loss, point.accuracy, -1,
+                         (Tracer::Now() - begin) * 1e-9};
+      //  A test pass that is cancelled keeps the last checkpoint, which
+      //  retrains the rest of this epoch
+      if (test) {
+        if (!TestPass_(network, *test, test->GetSize())) {
+          break;
+        }
+        result.test_accuracy = network->CalculateAccuracy();
+      }
+      epochs_.push_back(result);
+      state.test_accuracy.push_back(result.test_accuracy);
+      ++state.epoch;
+      state.cursor = 1;
+      save();
+    }
+    if (writer) {
+      writer->Flush();
+    }
+  });
+}
+
+void JobRunner::StartTesting(Network* network, const DataSet& test,
+                             size_t max_tests) {
+  Start_([this, network, &test, max_tests] {
+    TestPass_(network, test, max_tests);
+  });
+}
+
+void JobRunner::StartCrossValidation(const DataSet& data,
+                                     const CrossValidationOptions& options) {
+  //  The folds report no progress and can't be paused or cancelled
+  Start_([this, &data, options] {
+    folds_.clear();
+    num_epochs_ = options.num_epochs;
+    StartPass_(kPassCrossValidation, 0);
+    folds_ = RunCrossValidation(data, options);
+  });
+}
+
+bool JobRunner::TestPass_(Network* network, const DataSet& test,
+                          size_t max_tests) {
+  MLP_TRACE_SPAN("test pass");
+  network->ResetStatistics();
+  StartPass_(kPassTest, std::min(max_tests, test.GetSize()));
+  size_t count = 1;
+  for (bool more = Update_(0, 0); more;) {
+    more = network->TestNetwork(test, count, max_tests);
+    if (!Update_(count - 1, network->GetCountErrors())) {
+      return false;
+    }
+  }
+  return !cancel_;
+}
+
+void JobRunner::StartPass_(job_pass pass, size_t total) {
+  samples_.store(0, std::memory_order_relaxed);
+  errors_.store(0, std::memory_order_relaxed);
+  total_.store(total, std::memory_order_relaxed);
+  pass_begin_.store(Tracer::Now(), std::memory_order_relaxed);
+  pass_.store(pass, std::memory_order_relaxed);
+}
+
+bool JobRunner::Update_(size_t samples, size_t errors) {
+  samples_.store(samples, std::memory_order_relaxed);
+  errors_.store(errors, std::memory_order_relaxed);
+  if (state_.load(std::memory_order_relaxed) == kJobPaused) {
+    MLP_TRACE_SPAN("paused");
+    std::unique_lock<std::mutex> lock(pause_mutex_);
+    resumed_.wait(lock, [this] { return state_ != kJobPaused; });
+  }
+  return !cancel_.load(std::memory_order_relaxed);
+}
+
+JobProgress JobRunner::GetProgress() const {
+  JobProgress progress;
+  progress.state = static_cast<job_state>(state_.load());
+  progress.pass =
+      static_cast<job_pass>(pass_.load(std::memory_order_relaxed));
+  progress.epoch = epoch_.load(std::memory_order_relaxed);
+  progress.num_epochs = num_epochs_.load(std::memory_order_relaxed);
+  progress.samples = samples_.load(std::memory_order_relaxed);
+  progress.total = total_.load(std::memory_order_relaxed);
+  progress.errors = errors_.load(std::memory_order_relaxed);
+  uint64_t end = end_.load();
+  uint64_t now = end ? end : Tracer::Now();
+  progress.elapsed = (now - begin_.load()) * 1e-9;
+  double pass_time =
+      (now - pass_begin_.load(std::memory_order_relaxed)) * 1e-9;
+  progress.samples_per_second =
+      pass_time > 0 ? progress.samples / pass_time : 0;
+  return progress;
+}
+
+bool JobRunner::IsRunning() const {
+  int state = state_.load();
+  return state == kJobRunning || state == kJobPaused;
+}
+
+void JobRunner::Pause() {
+  int running = kJobRunning;
+  state_.compare_exchange_strong(running, kJobPaused);
+}
+
+void JobRunner::Resume() {
+  {
+    std::lock_guard<std::mutex> lock(pause_mutex_);
+    int paused = kJobPaused;
+    state_.compare_exchange_strong(paused, kJobRunning);
+  }
+  resumed_.notify_all();
+}
+
+void JobRunner::Cancel() {
+  cancel_ = true;
+  Resume();
+}
+
+void JobRunner::Wait() {
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace s21
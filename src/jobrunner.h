@@ -0,0 +1,144 @@
+#ifndef SRC_JOBRUNNER_H_
+#define SRC_JOBRUNNER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "checkpoint.h"
+#include "crossvalidation.h"
+#include "dataset.h"
+#include "network.h"
+#include "snapshot.h"
+
+namespace s21 {
+
+typedef enum {
+  kJobIdle,
+  kJobRunning,
+  kJobPaused,
+  kJobCancelled,
+  kJobFinished,
+  kJobFailed
+} job_state;
+
+typedef enum {
+  kPassNone,
+  kPassTrain,
+  kPassTest,
+  kPassCrossValidation
+} job_pass;
+
+//  Snapshot of a running job. The fields are read one by one, so they may
+//  be a batch apart; samples and total are of the current pass
+struct JobProgress {
+  job_state state;
+  job_pass pass;
+  int epoch;
+  int num_epochs;
+  size_t samples;
+  size_t total;
+  size_t errors;
+  double elapsed;
+  double samples_per_second;
+};
+
+//  Train and test figures of one epoch; test_accuracy is negative without
+//  a test pass, time is of the training pass in seconds (0 for the epochs
+//  finished before a resume)
+struct EpochResult {
+  int epoch;
+  double loss;
+  double accuracy;
+  double test_accuracy;
+  double time;
+};
+
+//  Runs one training, testing or cross-validation job at a time on its own
+//  thread, so that a long or paused job never holds a pool worker. The job
+//  publishes its progress after every batch into relaxed atomics, so
+//  polling never blocks it, and checks for pause and cancel before each
+//  pass and between batches. Results are read once the job is no longer
+//  running; the network must not be used elsewhere meanwhile
+class JobRunner {
+ public:
+  JobRunner() : snapshots_(nullptr), snapshot_batches_(0) {}
+  JobRunner(const JobRunner&) = delete;
+  JobRunner& operator=(const JobRunner&) = delete;
+  ~JobRunner();
+
+  //  Shuffles the training set every epoch and, with a test set, runs a
+  //  test pass after each epoch. Checkpoints are taken every few batches,
+  //  after every epoch and on cancel, and written in the background
+  void StartTraining(Network* network, const DataSet& train,
+                     const DataSet* test, int num_epochs,
+                     const CheckpointOptions& checkpoints = {});
+  //  Continues the run saved in checkpoint, on the same datasets, with the
+  //  same weights and samples it would have had without the stop
+  void ResumeTraining(Network* network, const DataSet& train,
+                      const DataSet* test, const Checkpoint& checkpoint,
+                      const CheckpointOptions& checkpoints = {});
+  void StartTesting(Network* network, const DataSet& test, size_t max_tests);
+  void StartCrossValidation(const DataSet& data,
+                            const CrossValidationOptions& options);
+
+  JobProgress GetProgress() const;
+  bool IsRunning() const;
+  void Pause();
+  void Resume();
+  //  The job stops after its current batch
+  void Cancel();
+  //  Waits for the job to end and rethrows its error
+  void Wait();
+
+  //  Training jobs started afterwards publish their weights to snapshots
+  //  when they start, every few batches and after every epoch
+  void SetSnapshots(SnapshotStore* snapshots,
+                    size_t every_batches = kSnapshotBatches) {
+    snapshots_ = snapshots;
+    snapshot_batches_ = every_batches;
+  }
+
+  const std::vector<EpochResult>& GetEpochResults() const { return epochs_; }
+  const std::vector<FoldResult>& GetFolds() const { return folds_; }
+
+ private:
+  SnapshotStore* snapshots_;
+  size_t snapshot_batches_;
+  std::thread thread_;
+  std::exception_ptr error_;
+  std::atomic<int> state_{kJobIdle};
+  std::atomic<int> pass_{kPassNone};
+  std::atomic<int> epoch_{0};
+  std::atomic<int> num_epochs_{0};
+  std::atomic<size_t> samples_{0};
+  std::atomic<size_t> total_{0};
+  std::atomic<size_t> errors_{0};
+  std::atomic<uint64_t> begin_{0};
+  std::atomic<uint64_t> pass_begin_{0};
+  std::atomic<uint64_t> end_{0};
+  std::atomic<bool> cancel_{false};
+  std::mutex pause_mutex_;
+  std::condition_variable resumed_;
+  std::vector<EpochResult> epochs_;
+  std::vector<FoldResult> folds_;
+
+  void CheckIdle_() const;
+  template <typename Job>
+  void Start_(Job job);
+  void Train_(Network* network, const DataSet& train, const DataSet* test,
+              const Checkpoint& checkpoint,
+              const CheckpointOptions& checkpoints);
+  void StartPass_(job_pass pass, size_t total);
+  //  Publishes the progress, blocks while paused; false once cancelled
+  bool Update_(size_t samples, size_t errors);
+  bool TestPass_(Network* network, const DataSet& test, size_t max_tests);
+};
+
+}  // namespace s21
+
+#endif  //  SRC_JOBRUNNER_H_
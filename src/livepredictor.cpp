@@ -0,0 +1,106 @@
+#include "livepredictor.h"
+
+#include <algorithm>
+
+#include "tracer.h"
+
+namespace s21 {
+
+LivePredictor::LivePredictor(BatchForward forward, ResultSink on_result)
+    : forward_(std::move(forward)),
+      on_result_(std::move(on_result)),
+      pending_sequence_(0),
+      num_submitted_(0),
+      predicting_(false),
+      stop_(false),
+      num_predicted_(0) {
+  thread_ = std::thread(&LivePredictor::Work_, this);
+}
+
+LivePredictor::~LivePredictor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = nullptr;
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+uint64_t LivePredictor::Submit(ImageSource source) {
+  uint64_t sequence;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = std::move(source);
+    pending_sequence_ = sequence = ++num_submitted_;
+    submitted_ = std::chrono::steady_clock::now();
+  }
+  wake_.notify_one();
+  return sequence;
+}
+
+void LivePredictor::Cancel() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_ = nullptr;
+  idle_.notify_all();
+}
+
+void LivePredictor::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return !pending_ && !predicting_; });
+}
+
+void LivePredictor::Work_() {
+  Tracer::GetInstance().SetThreadName("live predictor");
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this] { return stop_ || pending_; });
+    if (!pending_) {
+      break;
+    }
+    ImageSource source = std::move(pending_);
+    pending_ = nullptr;
+    LivePrediction result;
+    result.sequence = pending_sequence_;
+    auto submitted = submitted_;
+    predicting_ = true;
+    lock.unlock();
+
+    auto begin = std::chrono::steady_clock::now();
+    try {
+      MLP_TRACE_SPAN("live predict");
+      uint8_t input[kInputLayerNeurons];
+      PreprocessImage(source(), input);
+      double outputs[kOutputLayerNeurons];
+      forward_(input, 1, outputs);
+      int letters[kOutputLayerNeurons];
+      for (int i = 0; i < kOutputLayerNeurons; ++i) {
+        letters[i] = i;
+      }
+      std::partial_sort(letters, letters + kTopLetters,
+                        letters + kOutputLayerNeurons,
+                        [&outputs](int a, int b) {
+                          return outputs[a] > outputs[b];
+                        });
+      for (int i = 0; i < kTopLetters; ++i) {
+        result.letters[i] = letters[i];
+        result.outputs[i] = outputs[letters[i]];
+      }
+    } catch (const std::exception& e) {
+      result.error = e.what();
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.predict_us =
+        std::chrono::duration<double, std::micro>(end - begin).count();
+    result.latency_us =
+        std::chrono::duration<double, std::micro>(end - submitted).count();
+    ++num_predicted_;
+    on_result_(result);
+
+    lock.lock();
+    predicting_ = false;
+    idle_.notify_all();
+  }
+}
+
+}  // namespace s21
@@ -0,0 +1,80 @@
+#ifndef SRC_LIVEPREDICTOR_H_
+#define SRC_LIVEPREDICTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "preprocess.h"
+#include "snapshot.h"
+
+namespace s21 {
+
+//  Letters reported by a live prediction, best first
+const int kTopLetters = 3;
+
+struct LivePrediction {
+  //  Of the image it answers, as returned by LivePredictor::Submit
+  uint64_t sequence = 0;
+  //  0-based letters and their outputs
+  int letters[kTopLetters] = {};
+  double outputs[kTopLetters] = {};
+  //  From Submit to the result, and of preprocess and forward alone
+  double latency_us = 0;
+  double predict_us = 0;
+  std::string error;
+};
+
+//  Predicts the newest of a stream of images on its own thread, e.g. a
+//  drawing while the stroke goes on. Only the newest image waits while one
+//  is predicted, so a burst costs at most two predictions and the last
+//  result is always of the last image. The image is taken by calling its
+//  source on the worker, which keeps conversions off the caller
+class LivePredictor {
+ public:
+  typedef std::function<InkImage()> ImageSource;
+  typedef std::function<void(const LivePrediction& result)> ResultSink;
+
+  //  forward gets one preprocessed image at a time, on_result is called on
+  //  the worker thread
+  LivePredictor(BatchForward forward, ResultSink on_result);
+  LivePredictor(const LivePredictor&) = delete;
+  LivePredictor& operator=(const LivePredictor&) = delete;
+  //  Drops the waiting image, waits for the one being predicted
+  ~LivePredictor();
+
+  //  Replaces the waiting image, returns its sequence number
+  uint64_t Submit(ImageSource source);
+  //  Forgets the waiting image. The one being predicted still gives its
+  //  result, the caller tells it apart by the sequence
+  void Cancel();
+  //  Waits until no image waits or is being predicted
+  void Flush();
+  size_t GetNumPredicted() const { return num_predicted_.load(); }
+
+ private:
+  BatchForward forward_;
+  ResultSink on_result_;
+  ImageSource pending_;
+  uint64_t pending_sequence_;
+  uint64_t num_submitted_;
+  std::chrono::steady_clock::time_point submitted_;
+  bool predicting_;
+  bool stop_;
+  std::atomic<size_t> num_predicted_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::thread thread_;
+
+  void Work_();
+};
+
+}  // namespace s21
+
+#endif  //  SRC_LIVEPREDICTOR_H_
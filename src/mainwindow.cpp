@@ -2,11 +2,12 @@
 
 #include <QFileDialog>
 #include <QGraphicsTextItem>
-#include <chrono>  // NOLINT(*)
+#include <cstdlib>
 
 #include "ui_mainwindow.h"
 
-s21::Controller* s21::Controller::controller_ = nullptr;
+//  How often the UI shows the progress of a background job
+static const int kJobPollMs = 100;
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent),
@@ -15,8 +16,11 @@ MainWindow::MainWindow(QWidget* parent)
       scene_(new QGraphicsScene),
       graph_scene_(new QGraphicsScene),
       network_instance_(new s21::MatrixNetwork),
-      graph_instance_(new s21::GraphNetwork) {
+      graph_instance_(new s21::GraphNetwork),
+      job_timer_(new QTimer(this)),
+      job_samples_(0) {
   ui->setupUi(this);
+  connect(job_timer_, &QTimer::timeout, this, &MainWindow::UpdateJob_);
   this->setFixedSize(this->geometry().width(), this->geometry().height());
   scene_->setSceneRect(0, 0, s21::kNumNeurons * 5, s21::kNumNeurons * 5);
   ui->graphicsViewLetter->setScene(scene_);
@@ -27,16 +31,35 @@ MainWindow::MainWindow(QWidget* parent)
 
   s21::Controller* ctrl = s21::Controller::GetInstance();
   ctrl->Connect(network_instance_, graph_instance_);
+  //  MLP_TRACE=<file> records a timeline of the session into <file>
+  if (std::getenv("MLP_TRACE")) {
+    ctrl->StartTrace();
+    s21::Tracer::GetInstance().SetThreadName("ui");
+  }
 }
 
 MainWindow::~MainWindow() {
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  //  The job uses the networks deleted below
+  ctrl->CancelJob();
+  try {
+    ctrl->WaitJob();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
   delete ui;
   delete draw_dialog_;
   delete scene_;
   delete graph_scene_;
   delete network_instance_;
   delete graph_instance_;
-  s21::Controller* ctrl = s21::Controller::GetInstance();
+  if (std::getenv("MLP_TRACE")) {
+    try {
+      ctrl->DumpTrace(std::getenv("MLP_TRACE"));
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+  }
   delete ctrl;
 }
 
@@ -65,6 +88,10 @@ void MainWindow::on_pushButtonInfo_clicked() {
                        QString::fromStdString(s21::kDataSetTrain));
   ui->textInfo->append("Test file:  " +
                        QString::fromStdString(s21::kDataSetTest));
+  ui->textInfo->append("IDX train file:  " +
+                       QString::fromStdString(s21::kDataSetTrainIdx));
+  ui->textInfo->append("IDX test file:  " +
+                       QString::fromStdString(s21::kDataSetTestIdx));
 
   str = "\nEmnistLetter:";
   ui->textInfo->append(str);
@@ -129,98 +156,200 @@ void MainWindow::on_pushButtonTrain_clicked() {
       " with LearningRate: " + ui->LearningRate->cleanText() + " ===");
   error_.clear();
   graph_scene_->clear();
-  std::ifstream fp(s21::kDataSetTrain);
-  if (fp.is_open()) {
-    for (int epoch = 1; epoch <= ui->LearningEpoch->value(); ++epoch) {
-      size_t g_begin = 0;
-      size_t g_end = 0;
-      if (ui->checkBoxCrossValidation->isChecked()) {
-        g_begin = (epoch - 1) * s21::kNumDataSetSamples /
-                      ui->LearningGroups->value() +
-                  1;
-        g_end = epoch * s21::kNumDataSetSamples / ui->LearningGroups->value();
-        ui->textInfo->append("G_begin: " + QString::number(g_begin) +
-                             " G_end: " + QString::number(g_end));
-      }
-      size_t count = 1;
-      for (; ctrl->TrainNetwork(fp, count, g_begin, g_end) &&
-             count <= s21::kNumDataSetSamples;) {
-        ui->textInfo->append(
-            QString::number(count - 1) +
-            " samples processed (epoch: " + QString::number(epoch) + ")");
-        QApplication::processEvents();
-      }
-      ui->textInfo->append(
-          QString::number(count - 1) +
-          " samples processed (epoch: " + QString::number(epoch) + ")");
-
-      std::ifstream fp_test(s21::kDataSetTest);
-      if (fp_test.is_open()) {
-        ctrl->ResetStatistics();
-        size_t count_test = 1;
-        ui->textInfo->append("=== " + QString::number(s21::kNumDataSetTests) +
-                             " Tests ===");
-        for (; ctrl->TestNetwork(fp_test, count_test, s21::kNumDataSetTests) &&
-               count_test <= s21::kNumDataSetTests;) {
-          QApplication::processEvents();
-        }
-        fp_test.close();
-      }
-      error_.push_back(1 - ctrl->CalculateAccuracy() / 100);
-      fp.clear();
-      fp.seekg(0, std::ios_base::beg);
-    }
+  s21::DataSet* train_data =
+      GetDataSet_(&train_data_, s21::kDataSetTrainIdx, s21::kDataSetTrain);
+  s21::DataSet* test_data =
+      ui->checkBoxTestEpoch->isChecked()
+          ? GetDataSet_(&test_data_, s21::kDataSetTestIdx, s21::kDataSetTest)
+          : nullptr;
+  if (train_data && ui->checkBoxCrossValidation->isChecked()) {
+    CrossValidation_(*train_data);
+  } else if (train_data) {
+    ctrl->ResetProfile();
+    s21::CheckpointOptions checkpoints;
+    checkpoints.file = s21::kCheckpointFile;
+    ctrl->StartTraining(*train_data, test_data, ui->LearningEpoch->value(),
+                        checkpoints);
+    StartJob_([this] { FinishTraining_(); });
+  } else {
+    EnableUI_();
+  }
+}
+
+void MainWindow::on_pushButtonResume_clicked() {
+  DisableUI_();
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  ui->textInfo->append("=== Resume training from " +
+                       QString::fromStdString(s21::kCheckpointFile) + " ===");
+  error_.clear();
+  graph_scene_->clear();
+  s21::DataSet* train_data =
+      GetDataSet_(&train_data_, s21::kDataSetTrainIdx, s21::kDataSetTrain);
+  s21::DataSet* test_data =
+      ui->checkBoxTestEpoch->isChecked()
+          ? GetDataSet_(&test_data_, s21::kDataSetTestIdx, s21::kDataSetTest)
+          : nullptr;
+  if (!train_data) {
+    EnableUI_();
+    return;
+  }
+  try {
+    s21::CheckpointOptions checkpoints;
+    checkpoints.file = s21::kCheckpointFile;
+    ctrl->ResetProfile();
+    ctrl->ResumeTraining(*train_data, test_data, s21::kCheckpointFile,
+                         checkpoints);
+  } catch (const std::exception& e) {
+    ui->textInfo->append(e.what());
+    EnableUI_();
+    return;
+  }
+  if (ctrl->GetType() == s21::kMatrixNet) {
+    ui->radioButtonMatrix->setChecked(true);
+  } else {
+    ui->radioButtonGraph->setChecked(true);
+  }
+  StartJob_([this] { FinishTraining_(); });
+}
 
-    ui->textInfo->append("Done");
-    fp.close();
+void MainWindow::FinishTraining_() {
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  for (auto& it : ctrl->GetEpochResults()) {
+    QString line = "Epoch " + QString::number(it.epoch) +
+                   ": train loss: " + QString::number(it.loss) +
+                   ", train accuracy: " +
+                   QString::number(it.accuracy * 100, 'g', 4) + " %";
+    if (it.test_accuracy >= 0) {
+      line += ", test accuracy: " +
+              QString::number(it.test_accuracy * 100, 'g', 4) + " %";
+    }
+    ui->textInfo->append(line);
+    error_.push_back(1 - (it.test_accuracy >= 0 ? it.test_accuracy
+                                                : it.accuracy));
   }
+  ui->textInfo->append("Done");
+  PrintProfile_();
+  PrintErrors_();
+}
+
+void MainWindow::PrintErrors_() {
   for (auto& it : error_) {
     ui->textInfo->append("Error: " + QString::number(it));
   }
   DrawGraph_();
-  EnableUI_();
 }
 
 void MainWindow::on_pushButtonTest_clicked() {
   DisableUI_();
   s21::Controller* ctrl = s21::Controller::GetInstance();
-  std::ifstream fp(s21::kDataSetTest);
-  if (fp.is_open()) {
-    ctrl->ResetStatistics();
-    size_t count = 1;
+  s21::DataSet* test_data =
+      GetDataSet_(&test_data_, s21::kDataSetTestIdx, s21::kDataSetTest);
+  if (test_data) {
+    ctrl->ResetProfile();
     size_t max_tests = static_cast<size_t>(s21::kNumDataSetTests *
                                            ui->BoxPartTests->value() / 100);
     ui->textInfo->append("=== " + QString::number(max_tests) + " Tests ===");
-    auto begin = std::chrono::high_resolution_clock::now();
-    for (; ctrl->TestNetwork(fp, count, max_tests) && count <= max_tests;) {
-      ui->textInfo->append(QString::number(count - 1) + " tests processed");
-      ui->textInfo->append(QString::number(ctrl->GetCountErrors()) +
-                           " tests failed");
-      QApplication::processEvents();
-    }
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<float> duration = end - begin;
-    fp.close();
-
-    ui->textInfo->append(QString::number(count - 1) + " tests processed");
-    ui->textInfo->append(QString::number(ctrl->GetCountErrors()) +
-                         " tests failed");
-    ui->textInfo->append("Done");
-
-    ui->labelAccuracy->setText(
-        QString::number(ctrl->CalculateAccuracy(), 'g', 4) + " %");
-    ui->labelPrecision->setText(
-        QString::number(ctrl->CalculatePrecision(), 'g', 4) + " %");
-    ui->labelRecall->setText(QString::number(ctrl->CalculateRecall(), 'g', 4) +
+    ctrl->StartTesting(*test_data, max_tests);
+    StartJob_([this] { FinishTesting_(); });
+  } else {
+    EnableUI_();
+  }
+}
+
+void MainWindow::FinishTesting_() {
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  s21::JobProgress progress = ctrl->GetJobProgress();
+  ui->textInfo->append(QString::number(progress.samples) +
+                       " tests processed");
+  ui->textInfo->append(QString::number(ctrl->GetCountErrors()) +
+                       " tests failed");
+  ui->textInfo->append("Done");
+
+  s21::MetricsReport metrics = ctrl->GetMetrics();
+  ui->textInfo->append("Top-5 accuracy: " +
+                       QString::number(metrics.top_k[4] * 100, 'g', 4) + " %");
+  ui->textInfo->append(
+      QString::fromStdString(s21::FormatClassMetrics(metrics)));
+  ui->labelAccuracy->setText(QString::number(metrics.accuracy * 100, 'g', 4) +
                              " %");
-    ui->labelFmeasure->setText(
-        QString::number(ctrl->CalculateFmeasure(), 'g', 4) + " %");
-    ui->labelTimeSpent->setText(QString::number(duration.count(), 'g', 4) +
-                                " s");
+  ui->labelPrecision->setText(
+      QString::number(metrics.macro_precision * 100, 'g', 4) + " %");
+  ui->labelRecall->setText(
+      QString::number(metrics.macro_recall * 100, 'g', 4) + " %");
+  ui->labelFmeasure->setText(
+      QString::number(metrics.macro_fmeasure * 100, 'g', 4) + " %");
+  ui->labelTimeSpent->setText(QString::number(progress.elapsed, 'g', 4) +
+                              " s");
+  PrintProfile_();
+}
+
+void MainWindow::StartJob_(std::function<void()> finish) {
+  finish_job_ = std::move(finish);
+  job_samples_ = 0;
+  ui->pushButtonPause->setText("Pause");
+  ui->pushButtonPause->setEnabled(true);
+  ui->pushButtonCancel->setEnabled(true);
+  job_timer_->start(kJobPollMs);
+}
+
+void MainWindow::UpdateJob_() {
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  MLP_PROFILE_ATTACH(ctrl->GetProfiler());
+  MLP_PROFILE_PHASE(s21::kPhaseUi);
+  MLP_TRACE_SPAN("ui");
+  bool running = ctrl->IsJobRunning();
+  s21::JobProgress progress = ctrl->GetJobProgress();
+  if (progress.samples != job_samples_ && progress.samples) {
+    job_samples_ = progress.samples;
+    if (progress.pass == s21::kPassTrain) {
+      ui->textInfo->append(
+          QString::number(progress.samples) + " samples processed (epoch: " +
+          QString::number(progress.epoch) + "/" +
+          QString::number(progress.num_epochs) + ", " +
+          QString::number(progress.samples_per_second, 'f', 0) +
+          " samples/s)");
+    } else if (progress.pass == s21::kPassTest) {
+      ui->textInfo->append(QString::number(progress.samples) +
+                           " tests processed, " +
+                           QString::number(progress.errors) + " failed");
+    }
+  }
+  if (running) {
+    return;
+  }
+  job_timer_->stop();
+  ui->pushButtonPause->setEnabled(false);
+  ui->pushButtonCancel->setEnabled(false);
+  try {
+    ctrl->WaitJob();
+    if (progress.state == s21::kJobCancelled) {
+      ui->textInfo->append("Cancelled");
+    }
+    finish_job_();
+  } catch (const std::exception& e) {
+    ui->textInfo->append(e.what());
   }
   EnableUI_();
 }
 
+void MainWindow::on_pushButtonPause_clicked() {
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  if (ctrl->GetJobProgress().state == s21::kJobPaused) {
+    ctrl->ResumeJob();
+    ui->pushButtonPause->setText("Pause");
+  } else {
+    ctrl->PauseJob();
+    ui->pushButtonPause->setText("Resume");
+  }
+}
+
+void MainWindow::on_pushButtonCancel_clicked() {
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  ctrl->CancelJob();
+  ui->pushButtonPause->setEnabled(false);
+  ui->pushButtonCancel->setEnabled(false);
+}
+
 void MainWindow::on_radioButtonMatrix_clicked() {
   s21::Controller* ctrl = s21::Controller::GetInstance();
   ctrl->SetCurrentNetwork(s21::kMatrixNet);
@@ -250,7 +379,12 @@ void MainWindow::on_checkBoxCrossValidation_clicked(bool checked) {
 
 void MainWindow::on_pushButtonGetImage_clicked() {
   draw_dialog_->exec();
-  ImageRecognition_();
+  //  Format_RGB32 is 0xffRRGGBB words, BGRA bytes on little-endian hosts
+  QImage image =
+      draw_dialog_->GetImage()->convertToFormat(QImage::Format_RGB32);
+  ImageRecognition_(s21::ToInkImage(image.constBits(), image.width(),
+                                    image.height(), image.bytesPerLine(),
+                                    s21::kBgra32));
 }
 
 void MainWindow::on_pushButtonLoadImage_clicked() {
@@ -263,25 +397,93 @@ void MainWindow::on_pushButtonLoadImage_clicked() {
                      Qt::SmoothTransformation);
     ui->textInfo->append("File:  " + QFileInfo(fileName).fileName() +
                          " loaded");
-    ImageRecognition_();
+    try {
+      ImageRecognition_(s21::LoadBmp(fileName.toStdString()));
+    } catch (const std::exception& e) {
+      ui->textInfo->append(e.what());
+    }
   }
 }
 
-void MainWindow::ImageRecognition_() {
-  QImage scaled_image(draw_dialog_->GetImage()->scaled(
-      s21::kNumNeurons * 5, s21::kNumNeurons * 5, Qt::IgnoreAspectRatio,
-      Qt::SmoothTransformation));
-  scene_->addPixmap(QPixmap::fromImage(scaled_image));
+void MainWindow::CrossValidation_(const s21::DataSet& train_data) {
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  s21::CrossValidationOptions options;
+  options.type = ctrl->GetType();
+  options.num_hidden_layers = static_cast<int>(ctrl->GetNumLayers()) - 2;
+  options.learning_rate = ui->LearningRate->value();
+  options.num_folds = ui->LearningGroups->value();
+  options.num_epochs = ui->LearningEpoch->value();
+  ui->textInfo->append("=== Cross validation: " +
+                       QString::number(options.num_folds) + " folds ===");
+  ctrl->StartCrossValidation(train_data, options);
+  StartJob_([this] { FinishCrossValidation_(); });
+  //  The folds run to the end
+  ui->pushButtonPause->setEnabled(false);
+  ui->pushButtonCancel->setEnabled(false);
+}
 
-  QImage real_image(draw_dialog_->GetImage()->scaled(
-      s21::kNumNeurons, s21::kNumNeurons, Qt::IgnoreAspectRatio,
-      Qt::SmoothTransformation));
-  std::vector<int> input_layer;
-  for (int i = 0; i < s21::kNumNeurons; ++i) {
-    for (int j = 0; j < s21::kNumNeurons; ++j) {
-      input_layer.push_back(real_image.pixelColor(i, j).black());
+void MainWindow::FinishCrossValidation_() {
+  const std::vector<s21::FoldResult>& folds =
+      s21::Controller::GetInstance()->GetFolds();
+  for (auto& it : folds) {
+    ui->textInfo->append(
+        "Fold " + QString::number(it.fold + 1) +
+        ": accuracy " + QString::number(it.accuracy * 100, 'g', 4) +
+        " %, precision " + QString::number(it.precision * 100, 'g', 4) +
+        " %, recall " + QString::number(it.recall * 100, 'g', 4) +
+        " %, f-measure " + QString::number(it.fmeasure * 100, 'g', 4) + " %");
+    error_.push_back(1 - it.accuracy);
+  }
+  s21::FoldResult mean = s21::AverageFolds(folds);
+  ui->labelAccuracy->setText(QString::number(mean.accuracy * 100, 'g', 4) +
+                             " %");
+  ui->labelPrecision->setText(QString::number(mean.precision * 100, 'g', 4) +
+                              " %");
+  ui->labelRecall->setText(QString::number(mean.recall * 100, 'g', 4) + " %");
+  ui->labelFmeasure->setText(QString::number(mean.fmeasure * 100, 'g', 4) +
+                             " %");
+  ui->labelTimeSpent->setText(QString::number(mean.time, 'g', 4) + " s");
+  ui->textInfo->append("Done");
+  PrintErrors_();
+}
+
+s21::DataSet* MainWindow::GetDataSet_(std::unique_ptr<s21::DataSet>* data,
+                                     const std::string& idx_file,
+                                     const std::string& csv_file) {
+  if (!*data) {
+    s21::Controller* ctrl = s21::Controller::GetInstance();
+    ui->textInfo->append("Loading dataset...");
+    QApplication::processEvents();
+    try {
+      if (QFileInfo::exists(QString::fromStdString(idx_file))) {
+        *data = ctrl->LoadDataSet(idx_file);
+      } else {
+        *data = ctrl->LoadDataSet(csv_file);
+      }
+      ui->textInfo->append(QString::number((*data)->GetSize()) +
+                           " samples loaded");
+    } catch (const std::exception& e) {
+      ui->textInfo->append(e.what());
+    }
+  }
+  return data->get();
+}
+
+void MainWindow::ImageRecognition_(const s21::InkImage& image) {
+  uint8_t input[s21::kInputLayerNeurons];
+  s21::PreprocessImage(image, input);
+  //  What the network sees, magnified
+  QImage seen(s21::kNumNeurons, s21::kNumNeurons, QImage::Format_Grayscale8);
+  for (int y = 0; y < s21::kNumNeurons; ++y) {
+    for (int x = 0; x < s21::kNumNeurons; ++x) {
+      seen.scanLine(y)[x] = 255 - input[x * s21::kNumNeurons + y];
     }
   }
+  scene_->addPixmap(QPixmap::fromImage(
+      seen.scaled(s21::kNumNeurons * 5, s21::kNumNeurons * 5,
+                  Qt::IgnoreAspectRatio, Qt::FastTransformation)));
+
+  std::vector<int> input_layer(input, input + s21::kInputLayerNeurons);
   s21::Controller* ctrl = s21::Controller::GetInstance();
   char result = static_cast<char>(ctrl->Predict(input_layer) + 65);
   ui->textInfo->append("Prediction: " + QString(result));
@@ -316,6 +518,7 @@ void MainWindow::EnableUI_() {
   ui->pushButtonOpenNet->setEnabled(true);
   ui->pushButtonSaveNet->setEnabled(true);
   ui->pushButtonTrain->setEnabled(true);
+  ui->pushButtonResume->setEnabled(true);
   ui->pushButtonTest->setEnabled(true);
   ui->pushButtonGetImage->setEnabled(true);
   ui->pushButtonLoadImage->setEnabled(true);
@@ -328,17 +531,27 @@ void MainWindow::EnableUI_() {
   ui->LearningRate->setEnabled(true);
   ui->LearningEpoch->setEnabled(true);
   ui->checkBoxCrossValidation->setEnabled(true);
+  ui->checkBoxTestEpoch->setEnabled(true);
   ui->LearningGroups->setEnabled(true);
 
   ui->SliderPartTests->setEnabled(true);
   ui->BoxPartTests->setEnabled(true);
 }
 
+void MainWindow::PrintProfile_() {
+  if (s21::kProfileEnabled) {
+    s21::Controller* ctrl = s21::Controller::GetInstance();
+    ui->textInfo->append(
+        QString::fromStdString(s21::FormatProfile(ctrl->GetProfile())));
+  }
+}
+
 void MainWindow::DisableUI_() {
   ui->pushButtonGenerateNet->setEnabled(false);
   ui->pushButtonOpenNet->setEnabled(false);
   ui->pushButtonSaveNet->setEnabled(false);
   ui->pushButtonTrain->setEnabled(false);
+  ui->pushButtonResume->setEnabled(false);
   ui->pushButtonTest->setEnabled(false);
   ui->pushButtonGetImage->setEnabled(false);
   ui->pushButtonLoadImage->setEnabled(false);
@@ -351,6 +564,7 @@ void MainWindow::DisableUI_() {
   ui->LearningRate->setEnabled(false);
   ui->LearningEpoch->setEnabled(false);
   ui->checkBoxCrossValidation->setEnabled(false);
+  ui->checkBoxTestEpoch->setEnabled(false);
   ui->LearningGroups->setEnabled(false);
 
   ui->SliderPartTests->setEnabled(false);
@@ -3,6 +3,8 @@
 
 #include <QGraphicsScene>
 #include <QMainWindow>
+#include <QTimer>
+#include <functional>
 
 #include "controller.h"
 #include "drawdialog.h"
@@ -30,6 +32,10 @@ class MainWindow : public QMainWindow {
 
   void on_pushButtonTrain_clicked();
   void on_pushButtonTest_clicked();
+  void on_pushButtonPause_clicked();
+  void on_pushButtonCancel_clicked();
+  void on_pushButtonResume_clicked();
+  void UpdateJob_();
 
   void on_radioButtonMatrix_clicked();
   void on_radioButtonGraph_clicked();
@@ -49,9 +55,25 @@ class MainWindow : public QMainWindow {
   s21::MatrixNetwork* network_instance_;
   s21::GraphNetwork* graph_instance_;
   std::vector<double> error_;
+  std::unique_ptr<s21::DataSet> train_data_;
+  std::unique_ptr<s21::DataSet> test_data_;
+  //  Polls the background job, finish_job_ runs once it has ended
+  QTimer* job_timer_;
+  std::function<void()> finish_job_;
+  size_t job_samples_;
 
-  void ImageRecognition_();
+  void StartJob_(std::function<void()> finish);
+  void FinishTraining_();
+  void FinishTesting_();
+  void FinishCrossValidation_();
+  void PrintErrors_();
+  void CrossValidation_(const s21::DataSet& train_data);
+  s21::DataSet* GetDataSet_(std::unique_ptr<s21::DataSet>* data,
+                            const std::string& idx_file,
+                            const std::string& csv_file);
+  void ImageRecognition_(const s21::InkImage& image);
   void DrawGraph_();
+  void PrintProfile_();
   void EnableUI_();
   void DisableUI_();
 };
@@ -1,5 +1,7 @@
 #include "matrix.h"
 
+#include "profiler.h"
+
 namespace s21 {
 
 Matrix::Matrix(int rows, int cols) : matrix_(nullptr) {
@@ -36,11 +38,20 @@ void Matrix::MulMatrixWithSigmoid(const Matrix& other) {
     throw std::range_error("Error: incompatible matrix dimensions");
   }
   Matrix result(rows_, other.cols_);
+  //  Each row of other is read once for all rows of this (a batch of input
+  //  vectors), the sums keep their k order
+  for (int k = 0; k < this->cols_; k++) {
+    const double* other_row = other.matrix_[k];
+    for (int i = 0; i < rows_; ++i) {
+      double value = this->matrix_[i][k];
+      double* result_row = result.matrix_[i];
+      for (int j = 0; j < other.cols_; ++j) {
+        result_row[j] += value * other_row[j];
+      }
+    }
+  }
   for (int i = 0; i < rows_; ++i) {
     for (int j = 0; j < other.cols_; ++j) {
-      for (int k = 0; k < this->cols_; k++) {
-        result.matrix_[i][j] += this->matrix_[i][k] * other.matrix_[k][j];
-      }
       result.matrix_[i][j] = Sigmoid(result.matrix_[i][j]);
     }
   }
@@ -149,6 +160,7 @@ int Matrix::MaxElement() {
 void Matrix::AllocateMem(int rows, int cols) {
   rows_ = rows;
   cols_ = cols;
+  MLP_PROFILE_CALL(AddAllocation(sizeof(double) * rows_ * cols_));
   matrix_ = new double*[rows_];
   for (int i = 0; i < rows_; i++) {
     matrix_[i] = new double[cols_]();
@@ -157,6 +169,7 @@ void Matrix::AllocateMem(int rows, int cols) {
 
 void Matrix::Clear() {
   if (matrix_) {
+    MLP_PROFILE_CALL(AddFree(sizeof(double) * rows_ * cols_));
     for (int i = 0; i < rows_; ++i) {
       delete[] matrix_[i];
     }
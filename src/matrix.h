@@ -18,6 +18,8 @@ class Matrix {
 
   int GetRows() const { return rows_; }
   int GetCols() const { return cols_; }
+  double* GetRow(int row) { return matrix_[row]; }
+  const double* GetRow(int row) const { return matrix_[row]; }
 
   void MulMatrix(const Matrix& other);
   void MulMatrixWithSigmoid(const Matrix& other);
@@ -1,5 +1,7 @@
 #include "matrixnetwork.h"
 
+#include <algorithm>
+
 namespace s21 {
 
 MatrixNetwork::MatrixNetwork() : MatrixNetwork(kNumHiddenLayers) {}
@@ -48,56 +50,20 @@ void MatrixNetwork::ShowNetwork() {
   }
 }
 
-bool MatrixNetwork::TrainNetwork(std::ifstream& fp, size_t& count,
-                                 size_t g_begin, size_t g_end) {
-  for (size_t max = count + kDataSetBatchSize; count < max && !fp.eof();
-       ++count) {
-    std::string line;
-    std::getline(fp, line);
-    if (line != "") {
-      if (count < g_begin || count > g_end) {
-        Matrix* vector;
-        ReadEmnistLetter(line);
-        vector = EmnistLetterToVector_();
-        CalculateVector_(vector);
-        CalculateDeltaWeights_(emnist_letter_.front());
-        UpdateWeights_();
-        delete vector;
-      }
-    }
-  }
-  if (!fp.eof()) {
-    return true;
-  } else {
-    return false;
-  }
+void MatrixNetwork::TrainLetter_() {
+  Matrix* vector = EmnistLetterToVector_();
+  CalculateVector_(vector);
+  AddTrainResult_(vector->GetRow(0));
+  CalculateDeltaWeights_(emnist_letter_.front());
+  UpdateWeights_();
+  delete vector;
 }
 
-bool MatrixNetwork::TestNetwork(std::ifstream& fp, size_t& count,
-                                size_t max_tests) {
-  for (size_t max = count + kDataSetBatchSize;
-       count < max && count <= max_tests && !fp.eof(); ++count) {
-    std::string line;
-    std::getline(fp, line);
-    if (line != "") {
-      Matrix* vector;
-      ReadEmnistLetter(line);
-      vector = EmnistLetterToVector_();
-      CalculateVector_(vector);
-      int max = vector->MaxElement();
-      ++(*confusion_matrix_)(emnist_letter_.front() - 1, max);
-      if (emnist_letter_.front() != vector->MaxElement() + 1) {
-        ++count_errors_;
-      }
-      delete vector;
-    }
-  }
-  if (!fp.eof()) {
-    return true;
-  } else {
-    --count;
-    return false;
-  }
+void MatrixNetwork::TestLetter_() {
+  Matrix* vector = EmnistLetterToVector_();
+  CalculateVector_(vector);
+  AddTestResult_(vector->GetRow(0));
+  delete vector;
 }
 
 Matrix* MatrixNetwork::EmnistLetterToVector_() {
@@ -114,6 +80,8 @@ Matrix* MatrixNetwork::EmnistLetterToVector_() {
 }
 
 void MatrixNetwork::CalculateVector_(Matrix* vector) {
+  MLP_PROFILE_PHASE(kPhaseForward);
+  MLP_TRACE_SPAN("forward");
   for (auto& it : layers_) {
     vector->MulMatrixWithSigmoid(*(it->GetMatrix()));
     *(it->GetVector()) = *vector;
@@ -121,6 +89,7 @@ void MatrixNetwork::CalculateVector_(Matrix* vector) {
 }
 
 void MatrixNetwork::SaveWeights(const std::string& weights_file) {
+  MLP_TRACE_SPAN("save weights");
   std::ofstream fp(weights_file);
   if (fp.is_open()) {
     fp << "Network weights:" << std::endl;
@@ -166,7 +135,38 @@ void MatrixNetwork::LoadWeights(const std::string& weights_file) {
   }
 }
 
+void MatrixNetwork::GetWeights(std::vector<double>* weights) {
+  weights->clear();
+  for (auto& it : layers_) {
+    Matrix* matrix = it->GetMatrix();
+    for (int i = 0; i < matrix->GetRows(); ++i) {
+      weights->insert(weights->end(), matrix->GetRow(i),
+                      matrix->GetRow(i) + matrix->GetCols());
+    }
+  }
+}
+
+void MatrixNetwork::SetWeights(size_t num_layers,
+                               const std::vector<double>& weights) {
+  if (weights.size() != CountWeights(num_layers)) {
+    throw std::invalid_argument("Error: incorrect number of weights");
+  }
+  if (num_layers != layers_.size()) {
+    GenerateNetwork(num_layers - 2);
+  }
+  const double* value = weights.data();
+  for (auto& it : layers_) {
+    Matrix* matrix = it->GetMatrix();
+    for (int i = 0; i < matrix->GetRows(); ++i) {
+      std::copy(value, value + matrix->GetCols(), matrix->GetRow(i));
+      value += matrix->GetCols();
+    }
+  }
+}
+
 void MatrixNetwork::CalculateDeltaWeights_(int expected) {
+  MLP_PROFILE_PHASE(kPhaseBackward);
+  MLP_TRACE_SPAN("backward");
   for (auto rit = layers_.rbegin(); rit != layers_.rend(); rit++) {
     if ((*rit)->GetType() == kOutputLayer) {
       for (int j = 0; j < (*((*rit)->GetDelta())).GetCols(); ++j) {
@@ -195,7 +195,11 @@ void MatrixNetwork::CalculateDeltaWeights_(int expected) {
 }
 
 void MatrixNetwork::UpdateWeights_() {
-  Matrix vector_prev = *EmnistLetterToVector_();
+  MLP_PROFILE_PHASE(kPhaseUpdate);
+  MLP_TRACE_SPAN("update");
+  Matrix* input = EmnistLetterToVector_();
+  Matrix vector_prev = *input;
+  delete input;
 
   for (auto& it : layers_) {
     for (int i = 0; i < it->GetMatrix()->GetRows(); ++i) {
@@ -208,16 +212,53 @@ void MatrixNetwork::UpdateWeights_() {
   }
 }
 
-int MatrixNetwork::Predict(const std::vector<int>& input_layer) {
-  Matrix* vector = new Matrix(1, kInputLayerNeurons);
-  int i = 0;
-  for (auto& it : input_layer) {
-    (*vector)(0, i++) = static_cast<double>(it) / 255.0;
+void MatrixNetwork::Forward(const uint8_t* image, double* outputs,
+                            InferenceWorkspace* workspace) const {
+  std::vector<double>& input = workspace->input;
+  std::vector<double>& output = workspace->output;
+  input.resize(kInputLayerNeurons);
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    input[i] = static_cast<double>(image[i]) / 255.0;
   }
-  CalculateVector_(vector);
-  int result = vector->MaxElement();
-  delete vector;
-  return result;
+  for (const Layer* it : layers_) {
+    const Matrix& weights = *it->GetMatrix();
+    output.assign(weights.GetCols(), 0);
+    //  The sums keep the order of Matrix::MulMatrixWithSigmoid
+    for (int k = 0; k < weights.GetRows(); ++k) {
+      const double* row = weights.GetRow(k);
+      for (int j = 0; j < weights.GetCols(); ++j) {
+        output[j] += input[k] * row[j];
+      }
+    }
+    for (auto& value : output) {
+      value = 1.0 / (1.0 + exp(-value));
+    }
+    input.swap(output);
+  }
+  std::copy(input.begin(), input.begin() + kOutputLayerNeurons, outputs);
+}
+
+void MatrixNetwork::PredictBatch(const uint8_t* images, size_t count,
+                                 double* outputs) const {
+  ThreadPool::GetDefault()->ParallelFor(
+      0, count, kPredictGrain, [&](size_t first, size_t last) {
+        Matrix batch(last - first, kInputLayerNeurons);
+        for (size_t i = first; i < last; ++i) {
+          double* row = batch.GetRow(i - first);
+          for (int j = 0; j < kInputLayerNeurons; ++j) {
+            row[j] =
+                static_cast<double>(images[i * kInputLayerNeurons + j]) / 255.0;
+          }
+        }
+        for (auto& it : layers_) {
+          batch.MulMatrixWithSigmoid(*(it->GetMatrix()));
+        }
+        for (size_t i = first; i < last; ++i) {
+          const double* row = batch.GetRow(i - first);
+          std::copy(row, row + kOutputLayerNeurons,
+                    outputs + i * kOutputLayerNeurons);
+        }
+      });
 }
 
 // std::pair<int, double> MatrixNetwork::Predict(const std::vector<int>&
@@ -19,14 +19,17 @@ class MatrixNetwork : public Network {
 
   void Clear();
 
-  bool TrainNetwork(std::ifstream& fp, size_t& count, size_t g_begin,
-                    size_t g_end) override;
-  bool TestNetwork(std::ifstream& fp, size_t& count, size_t max_tests) override;
-  int Predict(const std::vector<int>& input_layer) override;
+  void Forward(const uint8_t* image, double* outputs,
+               InferenceWorkspace* workspace) const override;
+  void PredictBatch(const uint8_t* images, size_t count,
+                    double* outputs) const override;
   // std::pair<int, double> Predict(const std::vector<int>& input_layer);
 
   void LoadWeights(const std::string& weights_file) override;
   void SaveWeights(const std::string& weights_file) override;
+  void GetWeights(std::vector<double>* weights) override;
+  void SetWeights(size_t num_layers,
+                  const std::vector<double>& weights) override;
   size_t GetNumLayers() override { return layers_.size(); }
 
   void GenerateNetwork(int num_hidden_layers) override;
@@ -58,6 +61,7 @@ class MatrixNetwork : public Network {
     }
     layer_type GetType() { return type_; }
     Matrix* GetMatrix() { return weights_; }
+    const Matrix* GetMatrix() const { return weights_; }
     Matrix* GetVector() { return vector_; }
     Matrix* GetDelta() { return delta_weights_; }
 
@@ -70,6 +74,10 @@ class MatrixNetwork : public Network {
 
   std::vector<Layer*> layers_;
 
+ protected:
+  //  Training phases, protected so benchmarks can time them one by one
+  void TrainLetter_() override;
+  void TestLetter_() override;
   Matrix* EmnistLetterToVector_();
   void CalculateVector_(Matrix* vector);
   void CalculateDeltaWeights_(int expected);
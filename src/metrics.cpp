@@ -0,0 +1,167 @@
+#include "metrics.h"
+
+#include <cstdio>
+
+namespace s21 {
+
+void ConfusionCounts::Merge(const ConfusionCounts& other) {
+  for (int i = 0; i < kNumClasses; ++i) {
+    for (int j = 0; j < kNumClasses; ++j) {
+      counts_[i][j] += other.counts_[i][j];
+    }
+    ranks_[i] += other.ranks_[i];
+  }
+}
+
+void ConfusionCounts::Reset() { *this = ConfusionCounts(); }
+
+uint64_t ConfusionCounts::GetTotal() const {
+  uint64_t total = 0;
+  for (int i = 0; i < kNumClasses; ++i) {
+    total += ranks_[i];
+  }
+  return total;
+}
+
+void MetricsAccumulator::Merge(const ConfusionCounts& counts) {
+  for (int i = 0; i < kNumClasses; ++i) {
+    for (int j = 0; j < kNumClasses; ++j) {
+      if (counts.Get(i, j)) {
+        counts_[i][j].fetch_add(counts.Get(i, j), std::memory_order_relaxed);
+      }
+    }
+    ranks_[i].fetch_add(counts.GetRankCount(i), std::memory_order_relaxed);
+  }
+}
+
+void MetricsAccumulator::Reset() {
+  for (int i = 0; i < kNumClasses; ++i) {
+    for (int j = 0; j < kNumClasses; ++j) {
+      counts_[i][j].store(0, std::memory_order_relaxed);
+    }
+    ranks_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+ConfusionCounts MetricsAccumulator::Snapshot() const {
+  ConfusionCounts counts;
+  for (int i = 0; i < kNumClasses; ++i) {
+    for (int j = 0; j < kNumClasses; ++j) {
+      counts.counts_[i][j] = counts_[i][j].load(std::memory_order_relaxed);
+    }
+    counts.ranks_[i] = ranks_[i].load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+static TrainingPoint Mean(TrainingPoint sum) {
+  if (sum.samples) {
+    sum.loss /= sum.samples;
+    sum.accuracy /= sum.samples;
+  }
+  return sum;
+}
+
+void TrainingCurve::FinishBatch() {
+  if (batch_.samples) {
+    batches_.push_back(Mean(batch_));
+    epoch_.samples += batch_.samples;
+    epoch_.loss += batch_.loss;
+    epoch_.accuracy += batch_.accuracy;
+    batch_ = TrainingPoint{};
+  }
+}
+
+void TrainingCurve::FinishEpoch() {
+  FinishBatch();
+  if (epoch_.samples) {
+    epochs_.push_back(Mean(epoch_));
+    epoch_ = TrainingPoint{};
+  }
+}
+
+void TrainingCurve::Restore(const TrainingPoint& epoch_sums,
+                            std::vector<TrainingPoint> batches,
+                            std::vector<TrainingPoint> epochs) {
+  batch_ = TrainingPoint{};
+  epoch_ = epoch_sums;
+  batches_ = std::move(batches);
+  epochs_ = std::move(epochs);
+}
+
+static double Ratio(uint64_t value, uint64_t total) {
+  return total ? static_cast<double>(value) / total : 0;
+}
+
+static double Harmonic(double a, double b) {
+  return a + b > 0 ? a * b * 2 / (a + b) : 0;
+}
+
+MetricsReport ComputeMetrics(const ConfusionCounts& counts) {
+  MetricsReport report{};
+  report.classes.resize(kNumClasses);
+  uint64_t true_positives = 0;
+  for (int i = 0; i < kNumClasses; ++i) {
+    for (int j = 0; j < kNumClasses; ++j) {
+      uint64_t count = counts.Get(i, j);
+      report.classes[i].support += count;
+      report.classes[j].predicted += count;
+    }
+    report.classes[i].true_positives = counts.Get(i, i);
+    true_positives += counts.Get(i, i);
+  }
+
+  int num_predicted = 0, num_present = 0;
+  for (auto& it : report.classes) {
+    report.total += it.support;
+    it.precision = Ratio(it.true_positives, it.predicted);
+    it.recall = Ratio(it.true_positives, it.support);
+    it.fmeasure = Harmonic(it.precision, it.recall);
+    if (it.predicted) {
+      report.macro_precision += it.precision;
+      ++num_predicted;
+    }
+    if (it.support) {
+      report.macro_recall += it.recall;
+      ++num_present;
+    }
+  }
+  report.errors = report.total - true_positives;
+  report.accuracy = Ratio(true_positives, report.total);
+  if (num_predicted) {
+    report.macro_precision /= num_predicted;
+  }
+  if (num_present) {
+    report.macro_recall /= num_present;
+  }
+  report.macro_fmeasure =
+      Harmonic(report.macro_precision, report.macro_recall);
+  //  Every sample has exactly one label and one prediction
+  report.micro_precision = report.accuracy;
+  report.micro_recall = report.accuracy;
+  report.micro_fmeasure = report.accuracy;
+
+  report.top_k.resize(kNumClasses);
+  uint64_t ranked = counts.GetTotal(), hits = 0;
+  for (int k = 0; k < kNumClasses; ++k) {
+    hits += counts.GetRankCount(k);
+    report.top_k[k] = Ratio(hits, ranked);
+  }
+  return report;
+}
+
+std::string FormatClassMetrics(const MetricsReport& report) {
+  std::string result = "Letter  Support  Precision  Recall  F-measure\n";
+  char line[64];
+  for (size_t i = 0; i < report.classes.size(); ++i) {
+    const ClassMetrics& it = report.classes[i];
+    std::snprintf(line, sizeof(line), "%c %13llu %10.4f %7.4f %10.4f\n",
+                  static_cast<char>('A' + i),
+                  static_cast<unsigned long long>(it.support),  // NOLINT(*)
+                  it.precision, it.recall, it.fmeasure);
+    result += line;
+  }
+  return result;
+}
+
+}  // namespace s21
@@ -0,0 +1,135 @@
+#ifndef SRC_METRICS_H_
+#define SRC_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace s21 {
+
+const int kNumClasses = 26;
+
+//  Integer confusion counts of one evaluator: counts_[label][predicted] and
+//  a histogram of the rank the true class got among the outputs (0 is the
+//  top-scored one), from which top-k accuracy follows for any k. Classes
+//  are 0-based. Not synchronized, meant to be owned by one thread and
+//  merged afterwards
+class ConfusionCounts {
+ public:
+  ConfusionCounts() : counts_{}, ranks_{} {}
+
+  void Add(int label, int predicted, int rank) {
+    ++counts_[label][predicted];
+    ++ranks_[rank];
+  }
+  void Merge(const ConfusionCounts& other);
+  void Reset();
+
+  uint64_t Get(int label, int predicted) const {
+    return counts_[label][predicted];
+  }
+  uint64_t GetRankCount(int rank) const { return ranks_[rank]; }
+  uint64_t GetTotal() const;
+
+ private:
+  uint64_t counts_[kNumClasses][kNumClasses];
+  uint64_t ranks_[kNumClasses];
+
+  friend class MetricsAccumulator;
+};
+
+//  Confusion counts with relaxed atomic cells: the evaluating thread adds
+//  without locks, other threads merge into it or take a snapshot while the
+//  evaluation is running (a snapshot may miss the samples in flight)
+class MetricsAccumulator {
+ public:
+  MetricsAccumulator() { Reset(); }
+  MetricsAccumulator(const MetricsAccumulator&) = delete;
+  MetricsAccumulator& operator=(const MetricsAccumulator&) = delete;
+
+  void Add(int label, int predicted, int rank) {
+    counts_[label][predicted].fetch_add(1, std::memory_order_relaxed);
+    ranks_[rank].fetch_add(1, std::memory_order_relaxed);
+  }
+  void Merge(const ConfusionCounts& counts);
+  void Reset();
+  ConfusionCounts Snapshot() const;
+
+ private:
+  std::atomic<uint64_t> counts_[kNumClasses][kNumClasses];
+  std::atomic<uint64_t> ranks_[kNumClasses];
+};
+
+struct ClassMetrics {
+  uint64_t support;
+  uint64_t predicted;
+  uint64_t true_positives;
+  double precision;
+  double recall;
+  double fmeasure;
+};
+
+//  Metrics are fractions (0..1). Macro precision is averaged over the
+//  classes that were predicted at least once, macro recall over the classes
+//  present in the data, macro F-measure is their harmonic mean.
+//  top_k[k - 1] is the top-k accuracy
+struct MetricsReport {
+  uint64_t total;
+  uint64_t errors;
+  double accuracy;
+  double macro_precision;
+  double macro_recall;
+  double macro_fmeasure;
+  double micro_precision;
+  double micro_recall;
+  double micro_fmeasure;
+  std::vector<double> top_k;
+  std::vector<ClassMetrics> classes;
+};
+
+//  Mean loss and accuracy over a run of training samples
+struct TrainingPoint {
+  size_t samples;
+  double loss;
+  double accuracy;
+};
+
+//  Learning curve built from the forward pass of training: one point per
+//  training batch and one per epoch
+class TrainingCurve {
+ public:
+  TrainingCurve() : batch_{}, epoch_{} {}
+
+  void Add(double loss, bool correct) {
+    batch_.samples += 1;
+    batch_.loss += loss;
+    batch_.accuracy += correct;
+  }
+  void FinishBatch();
+  void FinishEpoch();
+  void Reset() { *this = TrainingCurve(); }
+
+  const std::vector<TrainingPoint>& GetBatches() const { return batches_; }
+  const std::vector<TrainingPoint>& GetEpochs() const { return epochs_; }
+  //  Sums of the unfinished epoch, for checkpoints
+  const TrainingPoint& GetEpochSums() const { return epoch_; }
+  void Restore(const TrainingPoint& epoch_sums,
+               std::vector<TrainingPoint> batches,
+               std::vector<TrainingPoint> epochs);
+
+ private:
+  //  Sums until the batch/epoch is finished
+  TrainingPoint batch_, epoch_;
+  std::vector<TrainingPoint> batches_, epochs_;
+};
+
+//  All metrics in one pass over the counts
+MetricsReport ComputeMetrics(const ConfusionCounts& counts);
+
+//  Per-class table, one line per letter
+std::string FormatClassMetrics(const MetricsReport& report);
+
+}  // namespace s21
+
+#endif  //  SRC_METRICS_H_
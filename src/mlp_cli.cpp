@@ -0,0 +1,906 @@
+#include <signal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT(*)
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <mutex>  // NOLINT(*)
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>  // NOLINT(*)
+#include <vector>
+
+#include "controller.h"
+#include "decompressor.h"
+
+namespace s21 {
+
+const std::string kCliUsage =
+    "Usage: mlp_cli <train|test|predict|classify|cv|bench|serve|client> "
+    "[options]\n"
+    "  --type matrix|graph   network implementation (matrix)\n"
+    "  --layers N            hidden layers for a new network (2)\n"
+    "  --lr X                learning rate (0.4)\n"
+    "  --epochs N            training epochs (1)\n"
+    "  --threads N           thread pool size, cv workers, loader readers\n"
+    "                        and client connections, 0 = cores (0)\n"
+    "  --pin 0|1             pin the pool threads to cores (0)\n"
+    "  --folds N             cross-validation folds (5)\n"
+    "  --train FILE          training dataset (csv, csv.gz, idx, bin)\n"
+    "  --test FILE           test dataset\n"
+    "  --image FILE          predict/client: one BMP image instead\n"
+    "  --dir DIR             classify: directory of BMP images\n"
+    "  --format csv|json     classify: rows or JSON lines (csv)\n"
+    "  --output FILE         classify: where to write them (stdout)\n"
+    "  --weights FILE        weights to load instead of a new network\n"
+    "  --model A,B,...       test/predict/classify: models of ./weights by\n"
+    "                        name or weights files, instead of the network\n"
+    "  --cache-mb N          memory of the loaded models (32)\n"
+    "  --ensemble mean|vote  test/predict/classify/bench: the models of\n"
+    "                        --model answer as one\n"
+    "  --save FILE           where to save the trained weights\n"
+    "  --checkpoint FILE     train: save checkpoints of the run there\n"
+    "  --checkpoint-batches N batches between two checkpoints (10)\n"
+    "  --resume FILE         train: continue the run of a checkpoint\n"
+    "  --limit N             samples to test/predict/bench, 0 = all (0)\n"
+    "  --trace FILE          write a Chrome/Perfetto trace of the run\n"
+    "  --socket PATH         inference server socket (/tmp/mlp.sock)\n"
+    "  --batch N             server: most images per batch (32)\n"
+    "  --wait-us N           server: longest wait for a batch to fill (1000)\n"
+    "  --queue N             server: most images waiting (1024)\n"
+    "  --connections N       server: most clients (64)\n"
+    "  --request N           client: images per request (1)\n";
+
+struct CliOptions {
+  std::string command;
+  net_type type = kMatrixNet;
+  int layers = kNumHiddenLayers;
+  double learning_rate = 0.4;
+  int epochs = 1;
+  size_t threads = 0;
+  bool pin = false;
+  size_t folds = 5;
+  std::string train_file;
+  std::string test_file;
+  std::string image_file;
+  std::string dir;
+  bool json = false;
+  std::string output_file;
+  std::string weights_file;
+  std::vector<std::string> models;
+  size_t cache_mb = kModelCacheBytes >> 20;
+  bool use_ensemble = false;
+  ensemble_mode ensemble = kMeanProbability;
+  std::string save_file;
+  CheckpointOptions checkpoints;
+  std::string resume_file;
+  size_t limit = 0;
+  std::string trace_file;
+  ServerOptions server;
+  size_t request = 1;
+};
+
+//  Collects "key": value pairs of one JSON object
+class JsonObject {
+ public:
+  JsonObject() { out_ << std::setprecision(10); }
+
+  JsonObject& Add(const std::string& key, const std::string& value) {
+    return AddRaw(key, Quote(value));
+  }
+  JsonObject& Add(const std::string& key, const char* value) {
+    return AddRaw(key, Quote(value));
+  }
+  template <typename T>
+  JsonObject& Add(const std::string& key, T value) {
+    std::ostringstream number;
+    number << std::setprecision(10) << value;
+    return AddRaw(key, number.str());
+  }
+  JsonObject& AddRaw(const std::string& key, const std::string& json) {
+    out_ << (first_ ? "" : ", ") << Quote(key) << ": " << json;
+    first_ = false;
+    return *this;
+  }
+  std::string Str() const { return "{" + out_.str() + "}"; }
+
+  static std::string Quote(const std::string& value) {
+    std::string result = "\"";
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        result += '\\';
+        result += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char code[8];
+        std::snprintf(code, sizeof(code), "\\u%04x", c);
+        result += code;
+      } else {
+        result += c;
+      }
+    }
+    return result + "\"";
+  }
+
+ private:
+  std::ostringstream out_;
+  bool first_ = true;
+};
+
+static std::string JsonArray(const std::vector<std::string>& items) {
+  std::string result = "[";
+  for (size_t i = 0; i < items.size(); ++i) {
+    result += (i ? ", " : "") + items[i];
+  }
+  return result + "]";
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       begin)
+      .count();
+}
+
+static CliOptions ParseOptions(int argc, char* argv[]) {
+  if (argc < 2) {
+    throw std::invalid_argument("Error: no command given");
+  }
+  CliOptions options;
+  options.command = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    std::string key = argv[i];
+    if (i + 1 >= argc) {
+      throw std::invalid_argument("Error: no value for " + key);
+    }
+    std::string value = argv[++i];
+    if (key == "--type") {
+      if (value != "matrix" && value != "graph") {
+        throw std::invalid_argument("Error: unknown network type " + value);
+      }
+      options.type = value == "matrix" ? kMatrixNet : kGraphNet;
+    } else if (key == "--layers") {
+      options.layers = std::stoi(value);
+      if (options.layers < kMinHiddenLayers ||
+          options.layers > kMaxHiddenLayers) {
+        throw std::out_of_range("Error: incorrect number of hidden layers");
+      }
+    } else if (key == "--lr") {
+      options.learning_rate = std::stod(value);
+    } else if (key == "--epochs") {
+      options.epochs = std::stoi(value);
+    } else if (key == "--threads") {
+      options.threads = std::stoul(value);
+    } else if (key == "--pin") {
+      options.pin = std::stoi(value) != 0;
+    } else if (key == "--folds") {
+      options.folds = std::stoul(value);
+    } else if (key == "--train") {
+      options.train_file = value;
+    } else if (key == "--test") {
+      options.test_file = value;
+    } else if (key == "--image") {
+      options.image_file = value;
+    } else if (key == "--dir") {
+      options.dir = value;
+    } else if (key == "--format") {
+      if (value != "csv" && value != "json") {
+        throw std::invalid_argument("Error: unknown format " + value);
+      }
+      options.json = value == "json";
+    } else if (key == "--output") {
+      options.output_file = value;
+    } else if (key == "--weights") {
+      options.weights_file = value;
+    } else if (key == "--model") {
+      std::istringstream list(value);
+      for (std::string model; std::getline(list, model, ',');) {
+        options.models.push_back(model);
+      }
+    } else if (key == "--ensemble") {
+      if (value != "mean" && value != "vote") {
+        throw std::invalid_argument("Error: unknown ensemble " + value);
+      }
+      options.use_ensemble = true;
+      options.ensemble = value == "mean" ? kMeanProbability : kMajorityVote;
+    } else if (key == "--cache-mb") {
+      options.cache_mb = std::stoul(value);
+    } else if (key == "--save") {
+      options.save_file = value;
+    } else if (key == "--checkpoint") {
+      options.checkpoints.file = value;
+    } else if (key == "--checkpoint-batches") {
+      options.checkpoints.every_batches = std::stoul(value);
+    } else if (key == "--resume") {
+      options.resume_file = value;
+    } else if (key == "--limit") {
+      options.limit = std::stoul(value);
+    } else if (key == "--trace") {
+      options.trace_file = value;
+    } else if (key == "--socket") {
+      options.server.socket_path = value;
+    } else if (key == "--batch") {
+      options.server.max_batch = std::stoul(value);
+    } else if (key == "--wait-us") {
+      options.server.max_wait_us = std::stoul(value);
+    } else if (key == "--queue") {
+      options.server.max_queue = std::stoul(value);
+    } else if (key == "--connections") {
+      options.server.max_connections = std::stoul(value);
+    } else if (key == "--request") {
+      options.request = std::stoul(value);
+    } else {
+      throw std::invalid_argument("Error: unknown option " + key);
+    }
+  }
+  return options;
+}
+
+static void PrepareNetwork(Controller* ctrl, const CliOptions& options) {
+  ctrl->SetCurrentNetwork(options.type);
+  if (options.weights_file.empty()) {
+    ctrl->GenerateNetwork(options.layers);
+  } else {
+    std::string result = ctrl->LoadWeights(options.weights_file);
+    if (result != kWeightsLoaded) {
+      throw std::invalid_argument(result);
+    }
+  }
+  ctrl->SetLearningRate(options.learning_rate);
+  ctrl->ResetProfile();
+}
+
+static size_t Limit(const DataSet& data, const CliOptions& options) {
+  return options.limit ? std::min(options.limit, data.GetSize())
+                       : data.GetSize();
+}
+
+static std::string MetricsJson(const MetricsReport& metrics, double time) {
+  std::vector<std::string> classes;
+  for (size_t i = 0; i < metrics.classes.size(); ++i) {
+    const ClassMetrics& it = metrics.classes[i];
+    classes.push_back(JsonObject()
+                          .Add("letter", std::string(1, 'A' + i))
+                          .Add("support", it.support)
+                          .Add("precision", it.precision)
+                          .Add("recall", it.recall)
+                          .Add("fmeasure", it.fmeasure)
+                          .Str());
+  }
+  return JsonObject()
+      .Add("total", metrics.total)
+      .Add("errors", metrics.errors)
+      .Add("accuracy", metrics.accuracy)
+      .Add("macro_precision", metrics.macro_precision)
+      .Add("macro_recall", metrics.macro_recall)
+      .Add("macro_fmeasure", metrics.macro_fmeasure)
+      .Add("micro_fmeasure", metrics.micro_fmeasure)
+      .Add("top5_accuracy", metrics.top_k[4])
+      .Add("time", time)
+      .AddRaw("classes", JsonArray(classes))
+      .Str();
+}
+
+static std::string ProfileJson(const ProfileReport& profile) {
+  JsonObject result;
+  for (int i = 0; i < kNumPhases; ++i) {
+    result.AddRaw(kPhaseNames[i], JsonObject()
+                                      .Add("calls", profile.phases[i].calls)
+                                      .Add("time", profile.phases[i].time)
+                                      .Str());
+  }
+  return result.Add("samples", profile.samples)
+      .Add("samples_per_s", profile.samples_per_second)
+      .Add("bytes_read", profile.bytes_read)
+      .Add("allocations", profile.allocations)
+      .Add("peak_workspace", profile.peak_workspace)
+      .Str();
+}
+
+//  Adds the profile of the current network when built with MLP_PROFILE
+static JsonObject& AddProfile(JsonObject& result, Controller* ctrl) {
+  if (kProfileEnabled) {
+    result.AddRaw("profile", ProfileJson(ctrl->GetProfile()));
+  }
+  return result;
+}
+
+static std::string RunTest(Controller* ctrl, const DataSet& data,
+                           size_t max_tests) {
+  MLP_TRACE_SPAN("test pass");
+  auto begin = std::chrono::steady_clock::now();
+  ctrl->ResetStatistics();
+  size_t count = 1;
+  for (; ctrl->TestNetwork(data, count, max_tests);) {
+  }
+  return MetricsJson(ctrl->GetMetrics(), SecondsSince(begin));
+}
+
+//  Runs as a job, so that the checkpoints are those of the GUI
+static std::string Train(Controller* ctrl, const CliOptions& options) {
+  auto train = ctrl->LoadDataSet(
+      options.train_file.empty() ? kDataSetTrain : options.train_file);
+  if (options.resume_file.empty()) {
+    PrepareNetwork(ctrl, options);
+    ctrl->StartTraining(*train, nullptr, options.epochs, options.checkpoints);
+  } else {
+    ctrl->ResetProfile();
+    ctrl->ResumeTraining(*train, nullptr, options.resume_file,
+                         options.checkpoints);
+  }
+  ctrl->WaitJob();
+  const std::vector<TrainingPoint>& points = ctrl->GetEpochCurve();
+  std::vector<std::string> epochs;
+  for (auto& it : ctrl->GetEpochResults()) {
+    epochs.push_back(JsonObject()
+                         .Add("epoch", it.epoch)
+                         .Add("samples", points[it.epoch - 1].samples)
+                         .Add("loss", it.loss)
+                         .Add("accuracy", it.accuracy)
+                         .Add("time", it.time)
+                         .Str());
+  }
+  JsonObject result;
+  result.Add("command", options.command)
+      .Add("type", ctrl->GetType() == kMatrixNet ? "matrix" : "graph")
+      .Add("layers", ctrl->GetNumLayers() - 2)
+      .Add("learning_rate", ctrl->GetLearningRate())
+      .AddRaw("epochs", JsonArray(epochs));
+  if (!options.checkpoints.file.empty()) {
+    result.Add("checkpoint", options.checkpoints.file);
+  }
+  if (!options.test_file.empty()) {
+    auto test = ctrl->LoadDataSet(options.test_file);
+    result.AddRaw("test", RunTest(ctrl, *test, Limit(*test, options)));
+  }
+  if (!options.save_file.empty()) {
+    ctrl->SaveWeights(options.save_file);
+    result.Add("weights", options.save_file);
+  }
+  return AddProfile(result, ctrl).Str();
+}
+
+static const char* EnsembleName(ensemble_mode mode) {
+  return mode == kMeanProbability ? "mean" : "vote";
+}
+
+static std::vector<std::string> QuoteAll(
+    const std::vector<std::string>& values) {
+  std::vector<std::string> result;
+  for (auto& it : values) {
+    result.push_back(JsonObject::Quote(it));
+  }
+  return result;
+}
+
+//  Loads the models of --model at once, as an ensemble with --ensemble
+static void PrepareModels(Controller* ctrl, const CliOptions& options) {
+  if (options.models.empty()) {
+    throw std::invalid_argument("Error: no models");
+  }
+  ctrl->GetModels()->SetMaxBytes(options.cache_mb << 20);
+  auto begin = std::chrono::steady_clock::now();
+  if (options.use_ensemble) {
+    ctrl->SetEnsemble(options.models, options.ensemble);
+  } else {
+    ctrl->GetModels()->Preload(options.models);
+  }
+  std::cerr << "Loaded " << options.models.size() << " models in "
+            << SecondsSince(begin) << " s" << std::endl;
+}
+
+//  Every model of --model on the same samples, for A/B comparisons
+static std::string TestModels(Controller* ctrl, const CliOptions& options,
+                              const DataSet& data) {
+  PrepareModels(ctrl, options);
+  if (options.use_ensemble) {
+    auto begin = std::chrono::steady_clock::now();
+    MetricsReport metrics = ctrl->TestEnsemble(data, Limit(data, options));
+    return JsonObject()
+        .Add("command", options.command)
+        .Add("ensemble", EnsembleName(options.ensemble))
+        .AddRaw("models", JsonArray(QuoteAll(options.models)))
+        .AddRaw("test", MetricsJson(metrics, SecondsSince(begin)))
+        .Str();
+  }
+  std::vector<std::string> models;
+  for (auto& it : options.models) {
+    auto begin = std::chrono::steady_clock::now();
+    MetricsReport metrics = ctrl->TestModel(it, data, Limit(data, options));
+    models.push_back(
+        JsonObject()
+            .Add("model", it)
+            .AddRaw("test", MetricsJson(metrics, SecondsSince(begin)))
+            .Str());
+  }
+  ModelCacheStats stats = ctrl->GetModels()->GetStats();
+  return JsonObject()
+      .Add("command", options.command)
+      .AddRaw("models", JsonArray(models))
+      .Add("cache_hits", stats.hits)
+      .Add("cache_misses", stats.misses)
+      .Add("cache_evictions", stats.evictions)
+      .Str();
+}
+
+static std::string Test(Controller* ctrl, const CliOptions& options) {
+  auto test = ctrl->LoadDataSet(
+      options.test_file.empty() ? kDataSetTest : options.test_file);
+  if (!options.models.empty()) {
+    return TestModels(ctrl, options, *test);
+  }
+  PrepareNetwork(ctrl, options);
+  JsonObject result;
+  result.Add("command", options.command)
+      .AddRaw("test", RunTest(ctrl, *test, Limit(*test, options)));
+  return AddProfile(result, ctrl).Str();
+}
+
+//  The image is decoded and averaged down without Qt, as by the GUI
+static std::string PredictImage(Controller* ctrl, const CliOptions& options) {
+  PrepareNetwork(ctrl, options);
+  auto begin = std::chrono::steady_clock::now();
+  InkImage image = LoadBmp(options.image_file);
+  uint8_t input[kInputLayerNeurons];
+  PreprocessImage(image, input);
+  double preprocess_time = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  int prediction =
+      ctrl->Predict(std::vector<int>(input, input + kInputLayerNeurons));
+  return JsonObject()
+      .Add("command", options.command)
+      .Add("image", options.image_file)
+      .Add("width", image.width)
+      .Add("height", image.height)
+      .Add("prediction", std::string(1, 'A' + prediction))
+      .Add("preprocess_us", preprocess_time * 1e6)
+      .Add("predict_us", SecondsSince(begin) * 1e6)
+      .Str();
+}
+
+//  With --model, "prediction" holds the letter of every model by name
+//  unless they form an --ensemble
+static std::string Predict(Controller* ctrl, const CliOptions& options) {
+  if (!options.image_file.empty()) {
+    return PredictImage(ctrl, options);
+  }
+  if (options.models.empty()) {
+    PrepareNetwork(ctrl, options);
+  } else {
+    PrepareModels(ctrl, options);
+  }
+  auto data = ctrl->OpenDataSet(
+      options.test_file.empty() ? kDataSetTest : options.test_file);
+  std::vector<std::string> predictions;
+  std::vector<int> input_layer(kInputLayerNeurons);
+  for (size_t i = 0; i < Limit(*data, options); ++i) {
+    const uint8_t* image = data->GetImage(i);
+    input_layer.assign(image, image + kInputLayerNeurons);
+    JsonObject prediction;
+    prediction.Add("index", i).Add(
+        "label", std::string(1, 'A' + data->GetLabel(i) - 1));
+    if (options.models.empty()) {
+      prediction.Add("prediction",
+                     std::string(1, 'A' + ctrl->Predict(input_layer)));
+    } else if (options.use_ensemble) {
+      prediction.Add("prediction",
+                     std::string(1, 'A' + ctrl->PredictEnsemble(input_layer)));
+    } else {
+      JsonObject letters;
+      for (auto& it : options.models) {
+        letters.Add(it,
+                    std::string(1, 'A' + ctrl->PredictModel(it, input_layer)));
+      }
+      prediction.AddRaw("prediction", letters.Str());
+    }
+    predictions.push_back(prediction.Str());
+  }
+  return JsonObject()
+      .Add("command", options.command)
+      .AddRaw("predictions", JsonArray(predictions))
+      .Str();
+}
+
+static std::string CsvField(const std::string& value) {
+  if (value.find_first_of(",\"\n") == std::string::npos) {
+    return value;
+  }
+  std::string result = "\"";
+  for (char c : value) {
+    result += c == '"' ? "\"\"" : std::string(1, c);
+  }
+  return result + "\"";
+}
+
+//  Letters of the BMP images of --dir by the network, one model of --model
+//  or their --ensemble: a CSV row or JSON line per image to --output in
+//  the order of the names, then the totals
+static std::string Classify(Controller* ctrl, const CliOptions& options) {
+  if (options.dir.empty()) {
+    throw std::invalid_argument("Error: no directory given");
+  }
+  if (options.models.empty()) {
+    PrepareNetwork(ctrl, options);
+  } else if (options.use_ensemble || options.models.size() == 1) {
+    PrepareModels(ctrl, options);
+  } else {
+    throw std::invalid_argument("Error: classify takes one model or "
+                                "an ensemble");
+  }
+  std::ofstream file;
+  if (!options.output_file.empty()) {
+    file.open(options.output_file);
+    if (!file.is_open()) {
+      throw std::invalid_argument("Error: can't open the " +
+                                  options.output_file);
+    }
+  }
+  std::ostream& out = options.output_file.empty() ? std::cout : file;
+  if (!options.json) {
+    out << "file,prediction,confidence,decode_us,predict_us,error\n";
+  }
+  size_t num_rows = 0;
+  ImageSink sink = [&](const ImageResult& result) {
+    std::string letter =
+        result.prediction < 0 ? "" : std::string(1, 'A' + result.prediction);
+    if (options.json) {
+      JsonObject row;
+      row.Add("file", result.file)
+          .Add("prediction", letter)
+          .Add("confidence", result.confidence)
+          .Add("decode_us", result.decode_us)
+          .Add("predict_us", result.predict_us);
+      if (!result.error.empty()) {
+        row.Add("error", result.error);
+      }
+      out << row.Str() << '\n';
+    } else {
+      out << CsvField(result.file) << ',' << letter << ','
+          << result.confidence << ',' << result.decode_us << ','
+          << result.predict_us << ',' << CsvField(result.error) << '\n';
+    }
+    //  A batch at a time, so a reader sees the results as they come
+    if (++num_rows % kImageBatch == 0) {
+      out.flush();
+    }
+  };
+
+  ClassifyStats stats;
+  if (options.models.empty()) {
+    stats = ctrl->ClassifyDirectory(options.dir, sink);
+  } else if (options.use_ensemble) {
+    stats = ctrl->ClassifyDirectoryEnsemble(options.dir, sink);
+  } else {
+    stats = ctrl->ClassifyDirectoryModel(options.models[0], options.dir, sink);
+  }
+  out.flush();
+  double num_images = std::max<size_t>(stats.num_images, 1);
+  return JsonObject()
+      .Add("command", options.command)
+      .Add("dir", options.dir)
+      .Add("images", stats.num_images)
+      .Add("failed", stats.num_failed)
+      .Add("time", stats.seconds)
+      .Add("images_per_s",
+           stats.seconds > 0 ? stats.num_images / stats.seconds : 0)
+      .Add("decode_us", stats.decode_us / num_images)
+      .Add("predict_us", stats.predict_us / num_images)
+      .Str();
+}
+
+static std::string CrossValidate(Controller* ctrl, const CliOptions& options) {
+  auto train = ctrl->LoadDataSet(
+      options.train_file.empty() ? kDataSetTrain : options.train_file);
+  CrossValidationOptions cv;
+  cv.type = options.type;
+  cv.num_hidden_layers = options.layers;
+  cv.learning_rate = options.learning_rate;
+  cv.num_folds = options.folds;
+  cv.num_epochs = options.epochs;
+  cv.num_threads = options.threads;
+  std::vector<FoldResult> folds = ctrl->RunCrossValidation(*train, cv);
+  std::vector<std::string> items;
+  for (auto& it : folds) {
+    items.push_back(MetricsJson(ComputeMetrics(it.counts), it.time));
+  }
+  FoldResult average = AverageFolds(folds);
+  return JsonObject()
+      .Add("command", options.command)
+      .AddRaw("folds", JsonArray(items))
+      .Add("accuracy", average.accuracy)
+      .Add("precision", average.precision)
+      .Add("recall", average.recall)
+      .Add("fmeasure", average.fmeasure)
+      .Add("time", average.time)
+      .Str();
+}
+
+//  Test throughput and single-sample predict latency of the ensemble of
+//  --model next to those of its first model alone
+static std::string BenchEnsemble(Controller* ctrl, const CliOptions& options,
+                                 const DataSet& samples) {
+  CliOptions ensemble = options;
+  ensemble.use_ensemble = true;
+  PrepareModels(ctrl, ensemble);
+  const std::string& single = options.models.front();
+  size_t num_samples = samples.GetSize();
+  auto begin = std::chrono::steady_clock::now();
+  MetricsReport single_metrics = ctrl->TestModel(single, samples, num_samples);
+  double single_test_time = SecondsSince(begin);
+  begin = std::chrono::steady_clock::now();
+  MetricsReport metrics = ctrl->TestEnsemble(samples, num_samples);
+  double test_time = SecondsSince(begin);
+
+  std::vector<int> input_layer(kInputLayerNeurons);
+  double single_predict_time = 0, predict_time = 0;
+  for (size_t i = 0; i < num_samples; ++i) {
+    const uint8_t* image = samples.GetImage(i);
+    input_layer.assign(image, image + kInputLayerNeurons);
+    begin = std::chrono::steady_clock::now();
+    ctrl->PredictModel(single, input_layer);
+    single_predict_time += SecondsSince(begin);
+    begin = std::chrono::steady_clock::now();
+    ctrl->PredictEnsemble(input_layer);
+    predict_time += SecondsSince(begin);
+  }
+  return JsonObject()
+      .Add("command", options.command)
+      .Add("ensemble", EnsembleName(ensemble.ensemble))
+      .AddRaw("models", JsonArray(QuoteAll(options.models)))
+      .Add("samples", num_samples)
+      .Add("single_accuracy", single_metrics.accuracy)
+      .Add("accuracy", metrics.accuracy)
+      .Add("single_test_samples_per_s", num_samples / single_test_time)
+      .Add("test_samples_per_s", num_samples / test_time)
+      .Add("single_predict_latency_us",
+           single_predict_time * 1e6 / num_samples)
+      .Add("predict_latency_us", predict_time * 1e6 / num_samples)
+      .Str();
+}
+
+//  Throughput of the main paths on one dataset: parsing a CSV with the
+//  prefetching loader, one training epoch, a test pass and single-sample
+//  predict latency; with --model those of the ensemble instead
+static std::string Bench(Controller* ctrl, const CliOptions& options) {
+  std::string data_file =
+      options.train_file.empty() ? kDataSetTest : options.train_file;
+  if (!options.models.empty()) {
+    auto data = ctrl->LoadDataSet(data_file);
+    std::vector<size_t> indices(Limit(*data, options));
+    for (size_t i = 0; i < indices.size(); ++i) {
+      indices[i] = i;
+    }
+    return BenchEnsemble(ctrl, options, DataSetView(*data, indices));
+  }
+  JsonObject result;
+  result.Add("command", options.command)
+      .Add("type", options.type == kMatrixNet ? "matrix" : "graph");
+  std::string plain_file = StripCompressionExtension(data_file);
+  if (plain_file.size() > 4 &&
+      plain_file.compare(plain_file.size() - 4, 4, ".csv") == 0) {
+    size_t num_readers =
+        options.threads ? options.threads
+                        : std::max(1u, std::thread::hardware_concurrency());
+    auto begin = std::chrono::steady_clock::now();
+    size_t loaded = 0;
+    DataLoader loader(data_file, num_readers);
+    while (const SampleBatch* batch = loader.Next()) {
+      loaded += batch->GetSize();
+    }
+    result.Add("load_samples_per_s", loaded / SecondsSince(begin));
+  }
+
+  auto data = ctrl->LoadDataSet(data_file);
+  size_t num_samples = Limit(*data, options);
+  std::vector<size_t> indices(num_samples);
+  for (size_t i = 0; i < num_samples; ++i) {
+    indices[i] = i;
+  }
+  DataSetView samples(*data, indices);
+
+  PrepareNetwork(ctrl, options);
+  auto begin = std::chrono::steady_clock::now();
+  size_t count = 1;
+  for (; ctrl->TrainNetwork(samples, count, 0, 0);) {
+  }
+  double train_time = SecondsSince(begin);
+
+  begin = std::chrono::steady_clock::now();
+  count = 1;
+  for (; ctrl->TestNetwork(samples, count, num_samples);) {
+  }
+  double test_time = SecondsSince(begin);
+
+  std::vector<int> input_layer(kInputLayerNeurons);
+  begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < num_samples; ++i) {
+    const uint8_t* image = samples.GetImage(i);
+    input_layer.assign(image, image + kInputLayerNeurons);
+    ctrl->Predict(input_layer);
+  }
+  double predict_time = SecondsSince(begin);
+
+  AddProfile(result, ctrl);
+  return result.Add("samples", num_samples)
+      .Add("train_samples_per_s", num_samples / train_time)
+      .Add("test_samples_per_s", num_samples / test_time)
+      .Add("predict_latency_us", predict_time * 1e6 / num_samples)
+      .Str();
+}
+
+//  Serves the network until SIGINT or SIGTERM, then prints the stats
+static std::string Serve(Controller* ctrl, const CliOptions& options) {
+  PrepareNetwork(ctrl, options);
+  //  Blocked before the server threads start so that only sigwait gets them
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  auto begin = std::chrono::steady_clock::now();
+  auto server = ctrl->StartServer(options.server);
+  std::cerr << "Serving on " << options.server.socket_path << std::endl;
+  int signal = 0;
+  sigwait(&signals, &signal);
+  server->Stop();
+  return JsonObject()
+      .Add("command", options.command)
+      .Add("socket", options.server.socket_path)
+      .Add("time", SecondsSince(begin))
+      .AddRaw("stats", FormatServerStats(server->GetStats()))
+      .Str();
+}
+
+//  Sends a dataset to a running server from --threads connections and
+//  measures accuracy, throughput and the latency seen by the clients; with
+//  --image asks for the letter of that BMP
+static std::string Client(const CliOptions& options) {
+  if (!options.image_file.empty()) {
+    std::ifstream fp(options.image_file, std::ios::binary);
+    if (!fp.is_open()) {
+      throw std::invalid_argument("Error: can't open the " +
+                                  options.image_file);
+    }
+    std::vector<uint8_t> bmp((std::istreambuf_iterator<char>(fp)),
+                             std::istreambuf_iterator<char>());
+    std::vector<ServerPrediction> predictions;
+    InferenceClient client(options.server.socket_path);
+    if (client.PredictBmp(bmp.data(), bmp.size(), &predictions) !=
+        kServerOk) {
+      throw std::invalid_argument("Error: the server refused the image");
+    }
+    return JsonObject()
+        .Add("command", options.command)
+        .Add("image", options.image_file)
+        .Add("prediction", std::string(1, 'A' + predictions[0].label))
+        .Add("score", predictions[0].score)
+        .Str();
+  }
+  auto data = OpenDataSet(options.test_file.empty() ? kDataSetTest
+                                                    : options.test_file);
+  size_t num_samples = Limit(*data, options);
+  size_t num_clients = options.threads ? options.threads : 4;
+  size_t request = std::max<size_t>(options.request, 1);
+  std::vector<std::vector<double>> latencies(num_clients);
+  std::atomic<size_t> next(0), errors(0), rejected(0);
+  std::vector<std::thread> clients;
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t c = 0; c < num_clients; ++c) {
+    clients.emplace_back([&, c] {
+      try {
+        InferenceClient client(options.server.socket_path);
+        std::vector<uint8_t> images;
+        std::vector<ServerPrediction> predictions;
+        for (;;) {
+          size_t first = next.fetch_add(request);
+          if (first >= num_samples) {
+            break;
+          }
+          size_t count = std::min(request, num_samples - first);
+          images.clear();
+          for (size_t i = first; i < first + count; ++i) {
+            images.insert(images.end(), data->GetImage(i),
+                          data->GetImage(i) + kInputLayerNeurons);
+          }
+          auto sent = std::chrono::steady_clock::now();
+          if (client.Predict(images.data(), count, &predictions) !=
+              kServerOk) {
+            rejected += count;
+            continue;
+          }
+          latencies[c].push_back(SecondsSince(sent) * 1e6);
+          for (size_t i = 0; i < count; ++i) {
+            errors += static_cast<int>(predictions[i].label) + 1 !=
+                      data->GetLabel(first + i);
+          }
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        error = std::current_exception();
+      }
+    });
+  }
+  for (auto& it : clients) {
+    it.join();
+  }
+  double time = SecondsSince(begin);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  std::vector<double> all;
+  for (auto& it : latencies) {
+    all.insert(all.end(), it.begin(), it.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto percentile = [&all](double p) {
+    return all.empty() ? 0 : all[static_cast<size_t>(p * (all.size() - 1))];
+  };
+  size_t answered = num_samples - rejected;
+  return JsonObject()
+      .Add("command", options.command)
+      .Add("samples", num_samples)
+      .Add("rejected", rejected.load())
+      .Add("accuracy",
+           answered ? 1 - static_cast<double>(errors) / answered : 0.0)
+      .Add("images_per_s", answered / time)
+      .Add("latency_p50_us", percentile(0.5))
+      .Add("latency_p99_us", percentile(0.99))
+      .Add("latency_max_us", all.empty() ? 0 : all.back())
+      .AddRaw("server", InferenceClient(options.server.socket_path).GetStats())
+      .Str();
+}
+
+}  // namespace s21
+
+int main(int argc, char* argv[]) {
+  s21::MatrixNetwork matrix_network;
+  s21::GraphNetwork graph_network;
+  s21::Controller* ctrl = s21::Controller::GetInstance();
+  ctrl->Connect(&matrix_network, &graph_network);
+  int status = 0;
+  try {
+    s21::CliOptions options = s21::ParseOptions(argc, argv);
+    if (options.threads || options.pin) {
+      ctrl->SetThreadPool(options.threads, options.pin);
+    }
+    if (!options.trace_file.empty()) {
+      ctrl->StartTrace();
+      s21::Tracer::GetInstance().SetThreadName("main");
+    }
+    if (options.command == "train") {
+      std::cout << s21::Train(ctrl, options) << std::endl;
+    } else if (options.command == "test") {
+      std::cout << s21::Test(ctrl, options) << std::endl;
+    } else if (options.command == "predict") {
+      std::cout << s21::Predict(ctrl, options) << std::endl;
+    } else if (options.command == "classify") {
+      //  The results may take stdout
+      std::cerr << s21::Classify(ctrl, options) << std::endl;
+    } else if (options.command == "cv") {
+      std::cout << s21::CrossValidate(ctrl, options) << std::endl;
+    } else if (options.command == "bench") {
+      std::cout << s21::Bench(ctrl, options) << std::endl;
+    } else if (options.command == "serve") {
+      std::cout << s21::Serve(ctrl, options) << std::endl;
+    } else if (options.command == "client") {
+      std::cout << s21::Client(options) << std::endl;
+    } else {
+      throw std::invalid_argument("Error: unknown command " + options.command);
+    }
+    if (!options.trace_file.empty()) {
+      ctrl->DumpTrace(options.trace_file);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << s21::JsonObject().Add("error", e.what()).Str() << std::endl
+              << s21::kCliUsage;
+    status = 1;
+  }
+  delete ctrl;
+  return status;
+}
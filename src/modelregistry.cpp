@@ -0,0 +1,167 @@
+#include "modelregistry.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "tracer.h"
+
+namespace s21 {
+
+static size_t CountBytes(const WeightSnapshot& model) {
+  return sizeof(model) + model.GetWeights().size() * sizeof(double);
+}
+
+ModelRegistry::ModelRegistry(size_t max_bytes)
+    : max_bytes_(max_bytes),
+      bytes_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0),
+      num_loads_(0) {}
+
+void ModelRegistry::Register(const std::string& name,
+                             const std::string& weights_file) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  names_[name] = weights_file;
+}
+
+size_t ModelRegistry::RegisterDirectory(const std::string& dir) {
+  namespace fs = std::filesystem;
+  std::error_code error;
+  fs::directory_iterator it(dir, error);
+  if (error) {
+    throw std::invalid_argument("Error: can't open the " + dir);
+  }
+  size_t count = 0;
+  for (; it != fs::directory_iterator(); it.increment(error)) {
+    const fs::path& path = it->path();
+    if (it->is_regular_file(error) && path.extension() == ".txt") {
+      Register(path.stem().string(), path.string());
+      ++count;
+    }
+  }
+  return count;
+}
+
+std::vector<std::string> ModelRegistry::GetNames() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> names;
+  for (auto& it : names_) {
+    names.push_back(it.first);
+  }
+  return names;
+}
+
+std::string ModelRegistry::Resolve(const std::string& model) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Resolve_(model);
+}
+
+std::shared_ptr<const WeightSnapshot> ModelRegistry::Get(
+    const std::string& model) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::string weights_file = Resolve_(model);
+  auto it = entries_.find(weights_file);
+  if (it != entries_.end()) {
+    ++hits_;
+    if (it->second.model) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return it->second.model;
+    }
+    std::shared_future<Model> loading = it->second.loading;
+    lock.unlock();
+    return loading.get();
+  }
+  ++misses_;
+  std::promise<Model> promise;
+  entries_[weights_file].loading = promise.get_future().share();
+  uint64_t version = ++num_loads_;
+  lock.unlock();
+
+  Model loaded;
+  try {
+    MLP_TRACE_SPAN("load model");
+    size_t num_layers = 0;
+    std::vector<double> weights;
+    ReadWeights(weights_file, &num_layers, &weights);
+    loaded = std::make_shared<const WeightSnapshot>(version, num_layers,
+                                                    std::move(weights));
+  } catch (...) {
+    lock.lock();
+    entries_.erase(weights_file);
+    lock.unlock();
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+
+  lock.lock();
+  Entry& entry = entries_[weights_file];
+  entry.model = loaded;
+  entry.loading = std::shared_future<Model>();
+  lru_.push_front(weights_file);
+  entry.lru = lru_.begin();
+  bytes_ += CountBytes(*loaded);
+  EvictDown_();
+  lock.unlock();
+  promise.set_value(loaded);
+  return loaded;
+}
+
+void ModelRegistry::Preload(const std::vector<std::string>& models) {
+  ThreadPool::GetDefault()->ParallelFor(
+      0, models.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+          Get(models[i]);
+        }
+      });
+}
+
+bool ModelRegistry::IsLoaded(const std::string& model) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(Resolve_(model));
+  return it != entries_.end() && it->second.model;
+}
+
+void ModelRegistry::Evict(const std::string& model) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string weights_file = Resolve_(model);
+  auto it = entries_.find(weights_file);
+  if (it != entries_.end() && it->second.model) {
+    Erase_(weights_file);
+  }
+}
+
+void ModelRegistry::SetMaxBytes(size_t max_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_bytes_ = max_bytes;
+  EvictDown_();
+}
+
+ModelCacheStats ModelRegistry::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ModelCacheStats{hits_,        misses_, evictions_,
+                         lru_.size(), bytes_,  max_bytes_};
+}
+
+std::string ModelRegistry::Resolve_(const std::string& model) const {
+  auto it = names_.find(model);
+  return it != names_.end() ? it->second : model;
+}
+
+void ModelRegistry::Erase_(const std::string& weights_file) {
+  auto it = entries_.find(weights_file);
+  bytes_ -= CountBytes(*it->second.model);
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+  ++evictions_;
+}
+
+void ModelRegistry::EvictDown_() {
+  while (bytes_ > max_bytes_ && lru_.size() > 1) {
+    std::string weights_file = lru_.back();
+    Erase_(weights_file);
+  }
+}
+
+}  // namespace s21
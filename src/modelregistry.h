@@ -0,0 +1,93 @@
+#ifndef SRC_MODELREGISTRY_H_
+#define SRC_MODELREGISTRY_H_
+
+#include <cstdint>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "snapshot.h"
+
+namespace s21 {
+
+const std::string kWeightsDir = "./weights";
+//  Memory of the loaded models, about 40 models of 2 hidden layers
+const size_t kModelCacheBytes = size_t(32) << 20;
+
+struct ModelCacheStats {
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+  size_t num_loaded;
+  size_t bytes;
+  size_t max_bytes;
+};
+
+//  Ready-to-run models by name or weights file, loaded on first use and
+//  kept in an LRU cache bounded by memory. A model is an immutable
+//  WeightSnapshot, so one may serve any number of threads; an evicted
+//  model lives on while somebody still holds it. Thread-safe
+class ModelRegistry {
+ public:
+  explicit ModelRegistry(size_t max_bytes = kModelCacheBytes);
+  ModelRegistry(const ModelRegistry&) = delete;
+  ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+  //  A model may be named instead of given by its weights file
+  void Register(const std::string& name, const std::string& weights_file);
+  //  Registers every .txt file of dir by its name without the extension
+  //  and returns how many there were
+  size_t RegisterDirectory(const std::string& dir);
+  //  Registered names in order
+  std::vector<std::string> GetNames() const;
+  //  The weights file of a name, anything else is taken as a file
+  std::string Resolve(const std::string& model) const;
+
+  //  Loads the model on a miss. Loads of different models run at once,
+  //  callers of a model being loaded wait for that load
+  std::shared_ptr<const WeightSnapshot> Get(const std::string& model);
+  //  Loads the models at once on the default thread pool, rethrows the
+  //  first error
+  void Preload(const std::vector<std::string>& models);
+  bool IsLoaded(const std::string& model) const;
+  void Evict(const std::string& model);
+  //  The most recently used model is kept even if it alone is larger
+  void SetMaxBytes(size_t max_bytes);
+  ModelCacheStats GetStats() const;
+
+ private:
+  typedef std::shared_ptr<const WeightSnapshot> Model;
+
+  //  Either loaded or being loaded by one caller
+  struct Entry {
+    Model model;
+    std::shared_future<Model> loading;
+    std::list<std::string>::iterator lru;
+  };
+
+  std::map<std::string, std::string> names_;
+  //  By weights file
+  std::unordered_map<std::string, Entry> entries_;
+  //  Weights files of the loaded models, most recently used first
+  std::list<std::string> lru_;
+  size_t max_bytes_;
+  size_t bytes_;
+  size_t hits_;
+  size_t misses_;
+  size_t evictions_;
+  uint64_t num_loads_;
+  mutable std::mutex mutex_;
+
+  std::string Resolve_(const std::string& model) const;
+  void Erase_(const std::string& weights_file);
+  void EvictDown_();
+};
+
+}  // namespace s21
+
+#endif  //  SRC_MODELREGISTRY_H_
@@ -1,98 +1,272 @@
 #include "network.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include "dataloader.h"
+
 namespace s21 {
 
-void Network::ReadEmnistLetter(const std::string& line) {
-  emnist_letter_.clear();
-  std::string substr;
-  try {
-    for (auto it : line) {
-      if (it != ',') {
-        substr.push_back(it);
-      } else {
-        emnist_letter_.push_back(std::stoi(substr));
-        substr.clear();
-        ++it;
+size_t CountWeights(size_t num_layers) {
+  if (num_layers < kMinHiddenLayers + 2 || num_layers > kMaxHiddenLayers + 2) {
+    throw std::invalid_argument("Error: incorrect number of layers");
+  }
+  return kInputLayerNeurons * kHiddenLayerNeurons +
+         (num_layers - 2) * kHiddenLayerNeurons * kHiddenLayerNeurons +
+         kHiddenLayerNeurons * kOutputLayerNeurons;
+}
+
+void ReadWeights(const std::string& weights_file, size_t* num_layers,
+                 std::vector<double>* weights) {
+  MLP_TRACE_SPAN("read weights");
+  std::ifstream fp(weights_file, std::ios::binary);
+  if (!fp.is_open()) {
+    throw std::invalid_argument("Error: can't open the " + weights_file);
+  }
+  std::string text((std::istreambuf_iterator<char>(fp)),
+                   std::istreambuf_iterator<char>());
+  const std::string header = "Network weights:";
+  const std::invalid_argument format("Error: incorrect format of " +
+                                     weights_file);
+  if (text.compare(0, header.size(), header) != 0) {
+    throw format;
+  }
+  //  strtod gives the values std::stod gives LoadWeights
+  const char* it = text.c_str() + header.size();
+  char* end = nullptr;
+  *num_layers = std::strtoul(it, &end, 10);
+  if (end == it || *num_layers < kMinHiddenLayers + 2 ||
+      *num_layers > kMaxHiddenLayers + 2) {
+    throw format;
+  }
+  it = end;
+  weights->resize(CountWeights(*num_layers));
+  double* out = weights->data();
+  size_t rows = kInputLayerNeurons;
+  for (size_t layer = 0; layer < *num_layers; ++layer) {
+    size_t cols = layer + 1 == *num_layers ? kOutputLayerNeurons
+                                           : kHiddenLayerNeurons;
+    if (std::strtoul(it, &end, 10) != rows ||
+        std::strtoul(end, &end, 10) != cols) {
+      throw format;
+    }
+    it = end;
+    for (size_t i = 0; i < rows * cols; ++i) {
+      *out++ = std::strtod(it, &end);
+      if (end == it) {
+        throw format;
       }
+      it = end;
     }
-    emnist_letter_.push_back(std::stoi(substr));
-  } catch (const std::exception& e) {
-    throw std::invalid_argument("Error, incorrect dataset format");
+    rows = cols;
+  }
+}
+
+int Network::Predict(const std::vector<int>& input_layer) const {
+  static thread_local InferenceWorkspace workspace;
+  return Predict(input_layer, &workspace);
+}
+
+int Network::Predict(const std::vector<int>& input_layer,
+                     InferenceWorkspace* workspace) const {
+  if (input_layer.size() != kInputLayerNeurons) {
+    throw std::out_of_range("Error: incorrect size of the input layer");
   }
-  if (emnist_letter_.size() != kInputLayerNeurons + 1) {
-    throw std::length_error("Error, incorrect dataset format");
+  workspace->image.resize(kInputLayerNeurons);
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    workspace->image[i] = std::clamp(input_layer[i], 0, 255);
   }
+  workspace->result.resize(kOutputLayerNeurons);
+  double* outputs = workspace->result.data();
+  Forward(workspace->image.data(), outputs, workspace);
+  return std::max_element(outputs, outputs + kOutputLayerNeurons) - outputs;
 }
 
-//  Statistics
-//  https://towardsdatascience.com/precision-recall-and-f1-score-of-multiclass-classification-learn-in-depth-6c194b217629
+void Network::ReadEmnistLetter(const std::string& line) {
+  MLP_PROFILE_PHASE(kPhaseParse);
+  MLP_TRACE_SPAN("parse");
+  MLP_PROFILE_CALL(AddBytesRead(line.size() + 1));
+  emnist_letter_.resize(kInputLayerNeurons + 1);
+  ParseEmnistLetter(line, emnist_letter_.data());
+  //  The metrics index by the label, so it is checked like the pixels
+  if (emnist_letter_[0] < 1 || emnist_letter_[0] > kOutputLayerNeurons) {
+    throw std::invalid_argument("Error, incorrect dataset format: label " +
+                                std::to_string(emnist_letter_[0]));
+  }
+  for (int i = 1; i <= kInputLayerNeurons; ++i) {
+    if (emnist_letter_[i] < 0 || emnist_letter_[i] > 255) {
+      throw std::invalid_argument(
+          "Error, incorrect dataset format: pixel " +
+          std::to_string(emnist_letter_[i]));
+    }
+  }
+}
 
-double Network::CalculateAccuracy() {
-  int total = 0, true_positives = 0;
-  for (int i = 0; i < kOutputLayerNeurons; ++i) {
-    for (int j = 0; j < kOutputLayerNeurons; ++j) {
-      total += (*confusion_matrix_)(i, j);
-      if (i == j) {
-        true_positives += (*confusion_matrix_)(i, j);
+void Network::ReadEmnistLetter(const DataSet& data, size_t index) {
+  MLP_PROFILE_PHASE(kPhaseParse);
+  MLP_TRACE_SPAN("parse");
+  MLP_PROFILE_CALL(AddBytesRead(kInputLayerNeurons + 1));
+  const uint8_t* image = data.GetImage(index);
+  emnist_letter_.resize(kInputLayerNeurons + 1);
+  emnist_letter_[0] = data.GetLabel(index);
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    emnist_letter_[i + 1] = image[i];
+  }
+}
+
+bool Network::TrainNetwork(std::istream& fp, size_t& count, size_t g_begin,
+                           size_t g_end) {
+  MLP_PROFILE_ATTACH(&profiler_);
+  MLP_TRACE_SPAN("train batch");
+  for (size_t max = count + kDataSetBatchSize; count < max && !fp.eof();
+       ++count) {
+    std::string line;
+    std::getline(fp, line);
+    if (line != "") {
+      if (count < g_begin || count > g_end) {
+        ReadEmnistLetter(line);
+        TrainLetter_();
       }
     }
   }
-  return static_cast<double>(true_positives) / total;
+  curve_.FinishBatch();
+  if (!fp.eof()) {
+    return true;
+  } else {
+    return false;
+  }
 }
 
-double Network::CalculatePrecision() {
-  int total[kOutputLayerNeurons]{}, true_positives[kOutputLayerNeurons]{};
-  for (int i = 0; i < kOutputLayerNeurons; ++i) {
-    for (int j = 0; j < kOutputLayerNeurons; ++j) {
-      total[j] += (*confusion_matrix_)(i, j);
-      if (i == j) {
-        true_positives[j] = (*confusion_matrix_)(i, j);
-      }
+bool Network::TestNetwork(std::istream& fp, size_t& count, size_t max_tests) {
+  MLP_PROFILE_ATTACH(&profiler_);
+  MLP_TRACE_SPAN("test batch");
+  for (size_t max = count + kDataSetBatchSize;
+       count < max && count <= max_tests && !fp.eof(); ++count) {
+    std::string line;
+    std::getline(fp, line);
+    if (line != "") {
+      ReadEmnistLetter(line);
+      TestLetter_();
     }
   }
-  double precision = 0;
-  int exist_test = 0;
-  for (int i = 0; i < kOutputLayerNeurons; ++i) {
-    if (total[i] > 0) {
-      precision += static_cast<double>(true_positives[i]) / total[i];
-      ++exist_test;
+  if (!fp.eof()) {
+    return true;
+  } else {
+    --count;
+    return false;
+  }
+}
+
+bool Network::TrainNetwork(const DataSet& data, size_t& count, size_t g_begin,
+                           size_t g_end) {
+  MLP_PROFILE_ATTACH(&profiler_);
+  MLP_TRACE_SPAN("train batch");
+  for (size_t max = count + kDataSetBatchSize;
+       count < max && count <= data.GetSize(); ++count) {
+    if (count < g_begin || count > g_end) {
+      ReadEmnistLetter(data, count - 1);
+      TrainLetter_();
     }
   }
-  return precision / exist_test;
+  curve_.FinishBatch();
+  return count <= data.GetSize();
 }
 
-double Network::CalculateRecall() {
-  int total[kOutputLayerNeurons]{}, true_positives[kOutputLayerNeurons]{};
-  for (int i = 0; i < kOutputLayerNeurons; ++i) {
-    for (int j = 0; j < kOutputLayerNeurons; ++j) {
-      total[i] += (*confusion_matrix_)(i, j);
-      if (i == j) {
-        true_positives[i] = (*confusion_matrix_)(i, j);
-      }
+bool Network::TestNetwork(const DataSet& data, size_t& count,
+                          size_t max_tests) {
+  MLP_PROFILE_ATTACH(&profiler_);
+  MLP_TRACE_SPAN("test batch");
+  for (size_t max = count + kDataSetBatchSize;
+       count < max && count <= max_tests && count <= data.GetSize(); ++count) {
+    ReadEmnistLetter(data, count - 1);
+    TestLetter_();
+  }
+  return count <= std::min(max_tests, data.GetSize());
+}
+
+bool Network::TrainNetwork(DataLoader& loader, size_t& count, size_t g_begin,
+                           size_t g_end) {
+  MLP_PROFILE_ATTACH(&profiler_);
+  MLP_TRACE_SPAN("train batch");
+  const SampleBatch* batch = loader.Next();
+  if (!batch) {
+    return false;
+  }
+  for (size_t i = 0; i < batch->GetSize(); ++i) {
+    count = batch->GetIndex(i);
+    if (count < g_begin || count > g_end) {
+      ReadEmnistLetter(*batch, i);
+      TrainLetter_();
+    }
+  }
+  curve_.FinishBatch();
+  ++count;
+  return true;
+}
+
+bool Network::TestNetwork(DataLoader& loader, size_t& count,
+                          size_t max_tests) {
+  MLP_PROFILE_ATTACH(&profiler_);
+  MLP_TRACE_SPAN("test batch");
+  const SampleBatch* batch = loader.Next();
+  if (!batch) {
+    return false;
+  }
+  for (size_t i = 0; i < batch->GetSize(); ++i) {
+    count = batch->GetIndex(i);
+    if (count > max_tests) {
+      return false;
     }
+    ReadEmnistLetter(*batch, i);
+    TestLetter_();
   }
-  double precision = 0;
-  int exist_test = 0;
+  ++count;
+  return true;
+}
+
+void Network::AddTestResult_(const double* outputs) {
+  MLP_PROFILE_PHASE(kPhaseMetrics);
+  MLP_PROFILE_CALL(AddSamples(1));
+  int label = emnist_letter_.front() - 1, predicted = 0, rank = 0;
   for (int i = 0; i < kOutputLayerNeurons; ++i) {
-    if (total[i] > 0) {
-      precision += static_cast<double>(true_positives[i]) / total[i];
-      ++exist_test;
+    if (outputs[predicted] < outputs[i]) {
+      predicted = i;
+    }
+    if (outputs[label] < outputs[i]) {
+      ++rank;
     }
   }
-  return precision / exist_test;
+  metrics_.Add(label, predicted, rank);
 }
 
-double Network::CalculateFmeasure() {
-  return CalculatePrecision() * CalculateRecall() * 2 /
-         (CalculatePrecision() + CalculateRecall());
+void Network::AddTrainResult_(const double* outputs) {
+  MLP_PROFILE_PHASE(kPhaseMetrics);
+  MLP_PROFILE_CALL(AddSamples(1));
+  int label = emnist_letter_.front() - 1, predicted = 0;
+  double loss = 0;
+  for (int i = 0; i < kOutputLayerNeurons; ++i) {
+    if (outputs[predicted] < outputs[i]) {
+      predicted = i;
+    }
+    double error = (i == label) - outputs[i];
+    loss += error * error;
+  }
+  //  Squared error the backpropagation minimizes
+  curve_.Add(loss / 2, predicted == label);
 }
 
-void Network::ResetStatistics() {
-  count_errors_ = 0;
+void Network::ShowConfusionMatrix() {
+  ConfusionCounts counts = metrics_.Snapshot();
   for (int i = 0; i < kOutputLayerNeurons; ++i) {
     for (int j = 0; j < kOutputLayerNeurons; ++j) {
-      (*confusion_matrix_)(i, j) = 0;
+      std::cout << std::setw(6) << counts.Get(i, j);
     }
+    std::cout << std::endl;
   }
 }
 
@@ -1,20 +1,32 @@
 #ifndef SRC_NETWORK_H_
 #define SRC_NETWORK_H_
 
+#include <istream>
 #include <vector>
 
+#include "dataset.h"
 #include "matrix.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "threadpool.h"
+#include "tracer.h"
 
 namespace s21 {
 
 const size_t kNumDataSetSamples = 88800;
 const size_t kDataSetBatchSize = 1000;
 const size_t kNumDataSetTests = 14800;
+//  Images of one PredictBatch task on the thread pool
+const size_t kPredictGrain = 16;
 
 const std::string kDataSetTrain = "./datasets/emnist-letters-train.csv";
 const std::string kDataSetTrain_ = "./datasets/emnist-letters-myself2.csv";
 
 const std::string kDataSetTest = "./datasets/emnist-letters-test.csv";
+const std::string kDataSetTrainIdx =
+    "./datasets/emnist-letters-train-images-idx3-ubyte";
+const std::string kDataSetTestIdx =
+    "./datasets/emnist-letters-test-images-idx3-ubyte";
 const std::string kWeightsFile = "./weights/weights_2_784.txt";
 
 const int kSizeImage = 512;
@@ -25,26 +37,45 @@ const int kMaxHiddenLayers = 5;
 const int kNumNeurons = 28;
 
 const int kInputLayerNeurons = 784;
-const int kOutputLayerNeurons = 26;
+const int kOutputLayerNeurons = kNumClasses;
 const int kHiddenLayerNeurons = 100;
 const int kNumHiddenLayers = 2;
 
 typedef enum { kMatrixNet, kGraphNet } net_type;
 
+class DataLoader;
+
+//  Scratch of one inference call, a few KB of activations. A thread keeps
+//  its own across calls; one workspace is never used by two threads at once
+struct InferenceWorkspace {
+  std::vector<uint8_t> image;
+  std::vector<double> input;
+  std::vector<double> output;
+  std::vector<double> result;
+};
+
+//  Number of weights of a network with num_layers layers, throws unless
+//  it has kMinHiddenLayers to kMaxHiddenLayers hidden layers
+size_t CountWeights(size_t num_layers);
+//  Parses a weights file without building a network: its layers and all
+//  weights in the order of GetWeights
+void ReadWeights(const std::string& weights_file, size_t* num_layers,
+                 std::vector<double>* weights);
+
 class Network {
  public:
-  Network()
-      : type_(kMatrixNet),
-        learning_rate_(0.4),
-        count_errors_(0),
-        confusion_matrix_(
-            new Matrix(kOutputLayerNeurons, kOutputLayerNeurons)) {}
-  ~Network() { delete confusion_matrix_; }
+  Network() : type_(kMatrixNet), learning_rate_(0.4) {}
+  virtual ~Network() {}
 
   net_type GetType() { return type_; }
 
   void virtual LoadWeights(const std::string& weights_file) = 0;
   void virtual SaveWeights(const std::string& weights_file) = 0;
+  //  All weights in the order of the weights file (per layer, input by
+  //  input), the same for both network types
+  void virtual GetWeights(std::vector<double>* weights) = 0;
+  void virtual SetWeights(size_t num_layers,
+                          const std::vector<double>& weights) = 0;
 
   size_t virtual GetNumLayers() = 0;
   int GetInputLayerNeurons() { return kInputLayerNeurons; }
@@ -57,33 +88,80 @@ class Network {
 
   std::vector<int>& GetEmnistLetter() { return emnist_letter_; }
   void ReadEmnistLetter(const std::string& line);
+  void ReadEmnistLetter(const DataSet& data, size_t index);
 
   void SetLearningRate(double lr) { learning_rate_ = lr; }
-
-  bool virtual TrainNetwork(std::ifstream& fp, size_t& count, size_t g_begin,
-                            size_t g_end) = 0;
-  bool virtual TestNetwork(std::ifstream& fp, size_t& count,
-                           size_t max_tests) = 0;
-  int virtual Predict(const std::vector<int>& input_layer) = 0;
+  double GetLearningRate() const { return learning_rate_; }
+
+  bool TrainNetwork(std::istream& fp, size_t& count, size_t g_begin,
+                    size_t g_end);
+  bool TestNetwork(std::istream& fp, size_t& count, size_t max_tests);
+  bool TrainNetwork(const DataSet& data, size_t& count, size_t g_begin,
+                    size_t g_end);
+  bool TestNetwork(const DataSet& data, size_t& count, size_t max_tests);
+  bool TrainNetwork(DataLoader& loader, size_t& count, size_t g_begin,
+                    size_t g_end);
+  bool TestNetwork(DataLoader& loader, size_t& count, size_t max_tests);
+  //  Output layer of one image (kInputLayerNeurons pixels) into outputs
+  //  (kOutputLayerNeurons), the same values as the training forward pass.
+  //  Inference only reads the weights, so any number of threads may share
+  //  one network as long as it isn't trained or loaded meanwhile
+  void virtual Forward(const uint8_t* image, double* outputs,
+                       InferenceWorkspace* workspace) const = 0;
+  //  0-based letter of pixels 0..255, with the workspace of the calling
+  //  thread or a given one
+  int Predict(const std::vector<int>& input_layer) const;
+  int Predict(const std::vector<int>& input_layer,
+              InferenceWorkspace* workspace) const;
+  //  Output layers of count images (kInputLayerNeurons pixels each) into
+  //  outputs (kOutputLayerNeurons each). Chunks of kPredictGrain images run
+  //  on the default thread pool
+  void virtual PredictBatch(const uint8_t* images, size_t count,
+                            double* outputs) const = 0;
+
+  //  Loss and accuracy of the training pass, a batch point is closed by
+  //  every TrainNetwork call
+  const TrainingCurve& GetTrainingCurve() const { return curve_; }
+  void FinishTrainingEpoch() { curve_.FinishEpoch(); }
+  void ResetTrainingCurve() { curve_.Reset(); }
+  void SetTrainingCurve(const TrainingCurve& curve) { curve_ = curve; }
 
   //  Statistics
   //  https://towardsdatascience.com/precision-recall-and-f1-score-of-multiclass-classification-learn-in-depth-6c194b217629
 
-  double CalculateAccuracy();
-  double CalculatePrecision();
-  double CalculateRecall();
-  double CalculateFmeasure();
+  double CalculateAccuracy() { return GetMetrics().accuracy; }
+  double CalculatePrecision() { return GetMetrics().macro_precision; }
+  double CalculateRecall() { return GetMetrics().macro_recall; }
+  double CalculateFmeasure() { return GetMetrics().macro_fmeasure; }
+
+  //  Safe to call from another thread while testing is running
+  MetricsReport GetMetrics() const {
+    return ComputeMetrics(metrics_.Snapshot());
+  }
+  ConfusionCounts GetConfusionCounts() const { return metrics_.Snapshot(); }
+
+  //  Hot-path counters, filled only when built with MLP_PROFILE
+  Profiler* GetProfiler() { return &profiler_; }
 
-  void ResetStatistics();
-  size_t GetCountErrors() { return count_errors_; }
-  void ShowConfusionMatrix() { confusion_matrix_->Show(); }
+  void ResetStatistics() { metrics_.Reset(); }
+  size_t GetCountErrors() { return GetMetrics().errors; }
+  void ShowConfusionMatrix();
 
  protected:
   net_type type_;
   std::vector<int> emnist_letter_;
   double learning_rate_;
-  size_t count_errors_;
-  s21::Matrix* confusion_matrix_;
+  MetricsAccumulator metrics_;
+  TrainingCurve curve_;
+  Profiler profiler_;
+
+  //  Train/test on the letter held in emnist_letter_
+  void virtual TrainLetter_() = 0;
+  void virtual TestLetter_() = 0;
+  //  Records the output layer of a tested letter in the metrics
+  void AddTestResult_(const double* outputs);
+  //  Records the output layer of a letter before its weights update
+  void AddTrainResult_(const double* outputs);
 };
 
 }  // namespace s21
@@ -13,6 +13,7 @@ class Neuron {
   double& GetValue() { return value_; }
   double& GetDelta() { return delta_; }
   std::vector<double>& GetWeight() { return weight_; }
+  const std::vector<double>& GetWeight() const { return weight_; }
   std::vector<Neuron*>& GetInput() { return input_; }
 
   void ShowInputNeurons() {
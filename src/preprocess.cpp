@@ -0,0 +1,249 @@
+#include "preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "network.h"
+#include "tracer.h"
+
+namespace s21 {
+
+static uint32_t ReadU32(const uint8_t* data) {
+  return data[0] | data[1] << 8 | data[2] << 16 |
+         static_cast<uint32_t>(data[3]) << 24;
+}
+
+static uint16_t ReadU16(const uint8_t* data) { return data[0] | data[1] << 8; }
+
+static void ToInkRow(const uint8_t* pixels, int width, pixel_format format,
+                     uint8_t* ink) {
+  if (format == kGray8) {
+    for (int x = 0; x < width; ++x) {
+      ink[x] = 255 - pixels[x];
+    }
+    return;
+  }
+  int step = format == kBgr24 ? 3 : 4;
+  for (int x = 0; x < width; ++x, pixels += step) {
+    ink[x] = 255 - std::max({pixels[0], pixels[1], pixels[2]});
+  }
+}
+
+InkImage ToInkImage(const uint8_t* pixels, int width, int height,
+                    size_t stride, pixel_format format) {
+  if (width <= 0 || height <= 0 || width > kMaxImageSide ||
+      height > kMaxImageSide) {
+    throw std::invalid_argument("Error: incorrect size of the image");
+  }
+  InkImage image;
+  image.width = width;
+  image.height = height;
+  image.ink.resize(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; ++y) {
+    ToInkRow(pixels + y * stride, width, format,
+             image.ink.data() + static_cast<size_t>(y) * width);
+  }
+  return image;
+}
+
+InkImage DecodeBmp(const uint8_t* data, size_t size) {
+  MLP_TRACE_SPAN("decode bmp");
+  const std::invalid_argument format("Error: incorrect format of the BMP");
+  const size_t kFileHeader = 14, kInfoHeader = 40;
+  if (size < kFileHeader + kInfoHeader || data[0] != 'B' || data[1] != 'M') {
+    throw format;
+  }
+  uint32_t offset = ReadU32(data + 10);
+  uint32_t header_size = ReadU32(data + 14);
+  int32_t width = static_cast<int32_t>(ReadU32(data + 18));
+  int32_t height = static_cast<int32_t>(ReadU32(data + 22));
+  uint16_t bits = ReadU16(data + 28);
+  uint32_t compression = ReadU32(data + 30);
+  bool top_down = height < 0;
+  height = top_down ? -height : height;
+  if (header_size < kInfoHeader || width <= 0 || height <= 0 ||
+      width > kMaxImageSide || height > kMaxImageSide) {
+    throw format;
+  }
+  //  Rows are padded to 4 bytes
+  size_t stride = (static_cast<size_t>(width) * bits + 31) / 32 * 4;
+  if (offset > size || stride * height > size - offset) {
+    throw format;
+  }
+  const uint8_t* pixels = data + offset;
+  InkImage image;
+  image.width = width;
+  image.height = height;
+  image.ink.resize(static_cast<size_t>(width) * height);
+  auto row = [&](int y) {
+    return pixels + (top_down ? y : height - 1 - y) * stride;
+  };
+  auto ink = [&](int y) {
+    return image.ink.data() + static_cast<size_t>(y) * width;
+  };
+
+  if (bits == 1 && compression == 0) {
+    uint32_t num_colors = ReadU32(data + 46);
+    size_t palette = kFileHeader + header_size;
+    if (num_colors > 2 || palette + 8 > size) {
+      throw format;
+    }
+    uint8_t colors[2];
+    ToInkRow(data + palette, 2, kBgra32, colors);
+    for (int y = 0; y < height; ++y) {
+      const uint8_t* bits_row = row(y);
+      uint8_t* out = ink(y);
+      for (int x = 0; x < width; ++x) {
+        out[x] = colors[bits_row[x >> 3] >> (7 - (x & 7)) & 1];
+      }
+    }
+  } else if (bits == 24 && compression == 0) {
+    for (int y = 0; y < height; ++y) {
+      ToInkRow(row(y), width, kBgr24, ink(y));
+    }
+  } else if (bits == 32 && compression == 0) {
+    for (int y = 0; y < height; ++y) {
+      ToInkRow(row(y), width, kBgra32, ink(y));
+    }
+  } else if (bits == 32 && (compression == 3 || compression == 6)) {
+    //  Bitfields: masks of red, green and blue after the info header
+    if (kFileHeader + kInfoHeader + 12 > size) {
+      throw format;
+    }
+    uint32_t masks[3];
+    int shifts[3];
+    for (int c = 0; c < 3; ++c) {
+      masks[c] = ReadU32(data + kFileHeader + kInfoHeader + 4 * c);
+      shifts[c] = 0;
+      while (shifts[c] < 32 && !(masks[c] >> shifts[c] & 1)) {
+        ++shifts[c];
+      }
+      if (shifts[c] == 32 || masks[c] >> shifts[c] != 0xff) {
+        throw format;
+      }
+    }
+    for (int y = 0; y < height; ++y) {
+      const uint8_t* in = row(y);
+      uint8_t* out = ink(y);
+      for (int x = 0; x < width; ++x, in += 4) {
+        uint32_t pixel = ReadU32(in);
+        uint32_t value = 0;
+        for (int c = 0; c < 3; ++c) {
+          value = std::max(value, (pixel & masks[c]) >> shifts[c]);
+        }
+        out[x] = 255 - value;
+      }
+    }
+  } else {
+    throw std::invalid_argument("Error: unsupported BMP format");
+  }
+  return image;
+}
+
+InkImage LoadBmp(const std::string& bmp_file) {
+  //  One read of the whole file, a byte at a time is ten times slower
+  std::error_code error;
+  uintmax_t size = std::filesystem::file_size(bmp_file, error);
+  std::ifstream fp(bmp_file, std::ios::binary);
+  if (error || !fp.is_open()) {
+    throw std::invalid_argument("Error: can't open the " + bmp_file);
+  }
+  std::vector<uint8_t> data(size);
+  if (!fp.read(reinterpret_cast<char*>(data.data()), size)) {
+    throw std::invalid_argument("Error: can't read the " + bmp_file);
+  }
+  return DecodeBmp(data.data(), data.size());
+}
+
+//  For every output pixel of one axis the first source pixel, how many it
+//  covers and the fraction of each inside it
+struct AreaSpans {
+  std::vector<int> first;
+  std::vector<int> count;
+  std::vector<int> offset;
+  std::vector<float> weights;
+};
+
+static AreaSpans MakeAreaSpans(int source, int target) {
+  AreaSpans spans;
+  double scale = static_cast<double>(source) / target;
+  for (int i = 0; i < target; ++i) {
+    double begin = i * scale, end = (i + 1) * scale;
+    int first = static_cast<int>(begin);
+    int last = std::min(source, static_cast<int>(std::ceil(end)));
+    spans.first.push_back(first);
+    spans.count.push_back(last - first);
+    spans.offset.push_back(spans.weights.size());
+    for (int s = first; s < last; ++s) {
+      spans.weights.push_back(static_cast<float>(
+          std::min(end, s + 1.0) - std::max(begin, static_cast<double>(s))));
+    }
+  }
+  return spans;
+}
+
+//  Pixels of a source row summed at once by DownscaleArea
+static const int kRowBlock = 16;
+
+void DownscaleArea(const InkImage& image, int width, int height,
+                   uint8_t* pixels) {
+  MLP_TRACE_SPAN("downscale");
+  if (width <= 0 || height <= 0 || image.width <= 0 || image.height <= 0) {
+    throw std::invalid_argument("Error: incorrect size of the image");
+  }
+  AreaSpans rows = MakeAreaSpans(image.height, height);
+  AreaSpans cols = MakeAreaSpans(image.width, width);
+  float area = static_cast<float>(image.width) / width *
+               (static_cast<float>(image.height) / height);
+  std::vector<float> sums(image.width);
+  for (int y = 0; y < height; ++y) {
+    //  Weighted sum of whole source rows. Blocks of fixed length copied to
+    //  floats first, so the compiler vectorizes them even at -O2 without
+    //  checking whether the ink and the sums overlap
+    std::fill(sums.begin(), sums.end(), 0.0f);
+    float* sum = sums.data();
+    for (int i = 0; i < rows.count[y]; ++i) {
+      const uint8_t* ink = image.ink.data() +
+                           static_cast<size_t>(rows.first[y] + i) * image.width;
+      float weight = rows.weights[rows.offset[y] + i];
+      int x = 0;
+      for (; x + kRowBlock <= image.width; x += kRowBlock) {
+        float block[kRowBlock];
+        for (int j = 0; j < kRowBlock; ++j) {
+          block[j] = ink[x + j];
+        }
+        for (int j = 0; j < kRowBlock; ++j) {
+          sum[x + j] += weight * block[j];
+        }
+      }
+      for (; x < image.width; ++x) {
+        sum[x] += weight * ink[x];
+      }
+    }
+    for (int x = 0; x < width; ++x) {
+      const float* weights = cols.weights.data() + cols.offset[x];
+      const float* column = sum + cols.first[x];
+      float value = 0;
+      for (int i = 0; i < cols.count[x]; ++i) {
+        value += weights[i] * column[i];
+      }
+      pixels[y * width + x] =
+          static_cast<uint8_t>(std::min(value / area + 0.5f, 255.0f));
+    }
+  }
+}
+
+void PreprocessImage(const InkImage& image, uint8_t* input) {
+  uint8_t pixels[kInputLayerNeurons];
+  DownscaleArea(image, kNumNeurons, kNumNeurons, pixels);
+  for (int y = 0; y < kNumNeurons; ++y) {
+    for (int x = 0; x < kNumNeurons; ++x) {
+      input[x * kNumNeurons + y] = pixels[y * kNumNeurons + x];
+    }
+  }
+}
+
+}  // namespace s21
@@ -0,0 +1,47 @@
+#ifndef SRC_PREPROCESS_H_
+#define SRC_PREPROCESS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace s21 {
+
+//  Largest side of a decoded image
+const int kMaxImageSide = 16384;
+
+typedef enum { kGray8, kBgr24, kBgra32 } pixel_format;
+
+//  Row-major ink of an image: 255 - max(r, g, b), the QColor::black of a
+//  pixel, so that the background is 0 like in EMNIST
+struct InkImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> ink;
+};
+
+//  Pixels with rows stride bytes apart, e.g. the bits of a QImage in
+//  Format_RGB32 (kBgra32 on little-endian hosts)
+InkImage ToInkImage(const uint8_t* pixels, int width, int height,
+                    size_t stride, pixel_format format);
+
+//  Uncompressed BMP of 1, 24 or 32 bits per pixel (32 may use bitfields),
+//  bottom-up or top-down
+InkImage DecodeBmp(const uint8_t* data, size_t size);
+InkImage LoadBmp(const std::string& bmp_file);
+
+//  Area average into width x height row-major pixels: every output pixel
+//  is the mean of the source area it covers, edge pixels counted by the
+//  fraction inside. Separable, a pass over whole rows then one per column
+void DownscaleArea(const InkImage& image, int width, int height,
+                   uint8_t* pixels);
+
+//  The input layer of the network (kInputLayerNeurons pixels): the image
+//  averaged down to kNumNeurons x kNumNeurons and stored column by column,
+//  the orientation of the EMNIST images
+void PreprocessImage(const InkImage& image, uint8_t* input);
+
+}  // namespace s21
+
+#endif  //  SRC_PREPROCESS_H_
@@ -0,0 +1,84 @@
+#include "profiler.h"
+
+#include <cstdio>
+
+namespace s21 {
+
+void Profiler::AddAllocation(uint64_t bytes) {
+  Add_(&allocations_, 1);
+  Add_(&workspace_, bytes);
+  ObserveWorkspace(workspace_.load(std::memory_order_relaxed));
+}
+
+void Profiler::AddFree(uint64_t bytes) {
+  uint64_t workspace = workspace_.load(std::memory_order_relaxed);
+  //  Memory allocated before the profiler was attached isn't counted
+  workspace_.store(workspace > bytes ? workspace - bytes : 0,
+                   std::memory_order_relaxed);
+}
+
+void Profiler::ObserveWorkspace(uint64_t bytes) {
+  if (bytes > peak_workspace_.load(std::memory_order_relaxed)) {
+    peak_workspace_.store(bytes, std::memory_order_relaxed);
+  }
+}
+
+ProfileReport Profiler::GetReport() const {
+  ProfileReport report{};
+  double busy = 0;
+  for (int i = 0; i < kNumPhases; ++i) {
+    report.phases[i].calls = calls_[i].load(std::memory_order_relaxed);
+    report.phases[i].time = time_[i].load(std::memory_order_relaxed) * 1e-9;
+    if (i != kPhaseUi) {
+      busy += report.phases[i].time;
+    }
+  }
+  report.samples = samples_.load(std::memory_order_relaxed);
+  report.bytes_read = bytes_read_.load(std::memory_order_relaxed);
+  report.allocations = allocations_.load(std::memory_order_relaxed);
+  report.peak_workspace = peak_workspace_.load(std::memory_order_relaxed);
+  report.samples_per_second = busy > 0 ? report.samples / busy : 0;
+  return report;
+}
+
+void Profiler::Reset() {
+  for (int i = 0; i < kNumPhases; ++i) {
+    calls_[i].store(0, std::memory_order_relaxed);
+    time_[i].store(0, std::memory_order_relaxed);
+  }
+  samples_.store(0, std::memory_order_relaxed);
+  bytes_read_.store(0, std::memory_order_relaxed);
+  allocations_.store(0, std::memory_order_relaxed);
+  workspace_.store(0, std::memory_order_relaxed);
+  peak_workspace_.store(0, std::memory_order_relaxed);
+}
+
+std::string FormatProfile(const ProfileReport& report) {
+  std::string result;
+  char line[96];
+  for (int i = 0; i < kNumPhases; ++i) {
+    std::snprintf(line, sizeof(line), "%-9s %12llu calls %10.4f s\n",
+                  kPhaseNames[i],
+                  static_cast<unsigned long long>(  // NOLINT(*)
+                      report.phases[i].calls),
+                  report.phases[i].time);
+    result += line;
+  }
+  std::snprintf(line, sizeof(line),
+                "%llu samples, %.1f samples/s, %llu bytes read\n",
+                static_cast<unsigned long long>(report.samples),  // NOLINT(*)
+                report.samples_per_second,
+                static_cast<unsigned long long>(  // NOLINT(*)
+                    report.bytes_read));
+  result += line;
+  std::snprintf(line, sizeof(line),
+                "%llu allocations, %llu bytes peak workspace\n",
+                static_cast<unsigned long long>(  // NOLINT(*)
+                    report.allocations),
+                static_cast<unsigned long long>(  // NOLINT(*)
+                    report.peak_workspace));
+  result += line;
+  return result;
+}
+
+}  // namespace s21
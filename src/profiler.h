@@ -0,0 +1,160 @@
+#ifndef SRC_PROFILER_H_
+#define SRC_PROFILER_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT(*)
+#include <cstdint>
+#include <string>
+
+namespace s21 {
+
+//  Hot-path instrumentation, compiled in with MLP_PROFILE (make PROFILE=1).
+//  Without it the MLP_PROFILE_* macros expand to nothing and the reports
+//  stay zero
+
+#ifdef MLP_PROFILE
+const bool kProfileEnabled = true;
+#else
+const bool kProfileEnabled = false;
+#endif
+
+typedef enum {
+  kPhaseParse,
+  kPhaseForward,
+  kPhaseBackward,
+  kPhaseUpdate,
+  kPhaseMetrics,
+  kPhaseUi,
+  kNumPhases
+} profile_phase;
+
+const char* const kPhaseNames[kNumPhases] = {"parse",  "forward", "backward",
+                                             "update", "metrics", "ui"};
+
+struct PhaseReport {
+  uint64_t calls;
+  double time;
+};
+
+//  Times are in seconds, memory in bytes; samples_per_second is over the
+//  time of all phases but the UI
+struct ProfileReport {
+  PhaseReport phases[kNumPhases];
+  uint64_t samples;
+  uint64_t bytes_read;
+  uint64_t allocations;
+  uint64_t peak_workspace;
+  double samples_per_second;
+};
+
+//  Counters of one network. A single thread writes (relaxed load + store,
+//  no locked instructions), any thread may read a report
+class Profiler {
+ public:
+  Profiler() { Reset(); }
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  void AddTime(profile_phase phase, uint64_t nanoseconds) {
+    Add_(&calls_[phase], 1);
+    Add_(&time_[phase], nanoseconds);
+  }
+  void AddSamples(uint64_t samples) { Add_(&samples_, samples); }
+  void AddBytesRead(uint64_t bytes) { Add_(&bytes_read_, bytes); }
+  void AddAllocation(uint64_t bytes);
+  void AddFree(uint64_t bytes);
+  //  For buffers that are reused instead of allocated per sample
+  void ObserveWorkspace(uint64_t bytes);
+
+  ProfileReport GetReport() const;
+  void Reset();
+
+  //  Profiler the hot paths of the calling thread report to (or nullptr)
+  static Profiler*& Current() {
+    static thread_local Profiler* current = nullptr;
+    return current;
+  }
+
+ private:
+  std::atomic<uint64_t> calls_[kNumPhases];
+  std::atomic<uint64_t> time_[kNumPhases];
+  std::atomic<uint64_t> samples_;
+  std::atomic<uint64_t> bytes_read_;
+  std::atomic<uint64_t> allocations_;
+  std::atomic<uint64_t> workspace_;
+  std::atomic<uint64_t> peak_workspace_;
+
+  static void Add_(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+  }
+};
+
+//  Makes a profiler current for the calling thread until the end of scope
+class ProfileAttach {
+ public:
+  explicit ProfileAttach(Profiler* profiler) : previous_(Profiler::Current()) {
+    Profiler::Current() = profiler;
+  }
+  ~ProfileAttach() { Profiler::Current() = previous_; }
+
+ private:
+  Profiler* previous_;
+};
+
+//  Adds the time until the end of scope to a phase of the current profiler
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(profile_phase phase)
+      : profiler_(Profiler::Current()), phase_(phase) {
+    if (profiler_) {
+      begin_ = std::chrono::steady_clock::now();
+    }
+  }
+  ~PhaseTimer() {
+    if (profiler_) {
+      profiler_->AddTime(phase_,
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - begin_)
+                             .count());
+    }
+  }
+
+ private:
+  Profiler* profiler_;
+  profile_phase phase_;
+  std::chrono::steady_clock::time_point begin_;
+};
+
+//  One line per phase plus the totals
+std::string FormatProfile(const ProfileReport& report);
+
+}  // namespace s21
+
+#define MLP_PROFILE_CONCAT_(a, b) a##b
+#define MLP_PROFILE_NAME_(a, b) MLP_PROFILE_CONCAT_(a, b)
+
+#ifdef MLP_PROFILE
+#define MLP_PROFILE_ATTACH(profiler) \
+  s21::ProfileAttach MLP_PROFILE_NAME_(mlp_profile_attach_, __LINE__)(profiler)
+#define MLP_PROFILE_PHASE(phase) \
+  s21::PhaseTimer MLP_PROFILE_NAME_(mlp_profile_phase_, __LINE__)(phase)
+#define MLP_PROFILE_CALL(call)               \
+  do {                                       \
+    if (s21::Profiler::Current()) {          \
+      s21::Profiler::Current()->call;        \
+    }                                        \
+  } while (0)
+#else
+#define MLP_PROFILE_ATTACH(profiler) \
+  do {                               \
+  } while (0)
+#define MLP_PROFILE_PHASE(phase) \
+  do {                           \
+  } while (0)
+#define MLP_PROFILE_CALL(call) \
+  do {                         \
+  } while (0)
+#endif
+
+#endif  //  SRC_PROFILER_H_
@@ -0,0 +1,462 @@
+#include "server.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "tracer.h"
+
+namespace s21 {
+
+static bool ReadAll(int fd, void* data, size_t size) {
+  char* pos = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t result = recv(fd, pos, size, 0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    pos += result;
+    size -= result;
+  }
+  return true;
+}
+
+static bool WriteAll(int fd, const void* data, size_t size) {
+  const char* pos = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t result = send(fd, pos, size, MSG_NOSIGNAL);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    pos += result;
+    size -= result;
+  }
+  return true;
+}
+
+static bool WriteResponse(int fd, uint32_t status, uint32_t count) {
+  uint32_t header[3] = {kResponseMagic, status, count};
+  return WriteAll(fd, header, sizeof(header));
+}
+
+static sockaddr_un MakeAddress(const std::string& socket_path) {
+  sockaddr_un address{};
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("Error: socket path is too long");
+  }
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, socket_path.c_str());
+  return address;
+}
+
+std::string FormatServerStats(const ServerStats& stats) {
+  char line[512];
+  std::snprintf(line, sizeof(line),
+                "{\"requests\": %llu, \"images\": %llu, \"batches\": %llu, "
+                "\"rejected\": %llu, \"bad_requests\": %llu, "
+                "\"connections\": %zu, \"queue_depth\": %zu, "
+                "\"max_queue_depth\": %zu, \"mean_batch\": %.3f, "
+                "\"mean_latency_us\": %.1f, \"max_latency_us\": %.1f, "
+                "\"model_version\": %llu}",
+                static_cast<unsigned long long>(stats.requests),  // NOLINT(*)
+                static_cast<unsigned long long>(stats.images),    // NOLINT(*)
+                static_cast<unsigned long long>(stats.batches),   // NOLINT(*)
+                static_cast<unsigned long long>(stats.rejected),  // NOLINT(*)
+                static_cast<unsigned long long>(  // NOLINT(*)
+                    stats.bad_requests),
+                stats.connections, stats.queue_depth, stats.max_queue_depth,
+                stats.mean_batch, stats.mean_latency_us, stats.max_latency_us,
+                static_cast<unsigned long long>(  // NOLINT(*)
+                    stats.model_version));
+  return line;
+}
+
+InferenceServer::InferenceServer(Network* network,
+                                 const ServerOptions& options)
+    : network_(network),
+      snapshots_(nullptr),
+      options_(options),
+      listen_fd_(-1),
+      wake_fds_{-1, -1},
+      running_(false),
+      stopping_(false),
+      queued_images_(0),
+      stats_{},
+      total_latency_us_(0) {
+  options_.max_batch = std::max<size_t>(options_.max_batch, 1);
+}
+
+InferenceServer::InferenceServer(const SnapshotStore* snapshots,
+                                 const ServerOptions& options)
+    : InferenceServer(static_cast<Network*>(nullptr), options) {
+  if (!snapshots->Pin()) {
+    throw std::invalid_argument("Error: no weights published");
+  }
+  snapshots_ = snapshots;
+}
+
+void InferenceServer::Start() {
+  if (running_) {
+    return;
+  }
+  sockaddr_un address = MakeAddress(options_.socket_path);
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(options_.socket_path.c_str());
+  if (listen_fd_ < 0 ||
+      bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_fd_, SOMAXCONN) < 0 || pipe(wake_fds_) < 0) {
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+    }
+    throw std::invalid_argument("Error: can't listen on " +
+                                options_.socket_path);
+  }
+  stats_ = ServerStats{};
+  total_latency_us_ = 0;
+  stopping_ = false;
+  running_ = true;
+  batch_thread_ = std::thread(&InferenceServer::Batch_, this);
+  accept_thread_ = std::thread(&InferenceServer::Accept_, this);
+}
+
+void InferenceServer::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || stopping_) {
+      return;
+    }
+    stopping_ = true;
+  }
+  char wake = 0;
+  if (write(wake_fds_[1], &wake, 1) < 0) {
+    std::perror("server wake");
+  }
+  accept_thread_.join();
+  {
+    //  Wakes the connections blocked in a read, the ones waiting for a
+    //  result get it before they exit
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& it : connections_) {
+      if (!it.finished) {
+        shutdown(it.fd, SHUT_RDWR);
+      }
+    }
+  }
+  queued_.notify_all();
+  batch_thread_.join();
+  for (auto& it : connections_) {
+    it.thread.join();
+  }
+  connections_.clear();
+  close(listen_fd_);
+  close(wake_fds_[0]);
+  close(wake_fds_[1]);
+  unlink(options_.socket_path.c_str());
+  std::lock_guard<std::mutex> lock(mutex_);
+  running_ = false;
+}
+
+ServerStats InferenceServer::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ServerStats stats = stats_;
+  stats.connections = 0;
+  for (auto& it : connections_) {
+    stats.connections += !it.finished;
+  }
+  stats.queue_depth = queued_images_;
+  stats.mean_batch =
+      stats.batches ? static_cast<double>(stats.images) / stats.batches : 0;
+  stats.mean_latency_us =
+      stats.requests ? total_latency_us_ / stats.requests : 0;
+  return stats;
+}
+
+void InferenceServer::ReapConnections_() {
+  for (auto it = connections_.begin(); it != connections_.end();) {
+    if (it->finished) {
+      it->thread.join();
+      it = connections_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void InferenceServer::Accept_() {
+  Tracer::GetInstance().SetThreadName("server accept");
+  for (;;) {
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fds_[0], POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents) {
+      break;
+    }
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    ReapConnections_();
+    if (connections_.size() >= options_.max_connections) {
+      ++stats_.rejected;
+      lock.unlock();
+      WriteResponse(fd, kServerOverloaded, 0);
+      close(fd);
+      continue;
+    }
+    connections_.push_back(Connection{fd, false, std::thread()});
+    Connection* connection = &connections_.back();
+    connection->thread =
+        std::thread(&InferenceServer::Serve_, this, connection);
+  }
+}
+
+void InferenceServer::Serve_(Connection* connection) {
+  int fd = connection->fd;
+  std::vector<uint8_t> images;
+  std::vector<ServerPrediction> predictions;
+  uint32_t header[2];
+  while (ReadAll(fd, header, sizeof(header))) {
+    if (header[0] == kStatsMagic) {
+      std::string stats = FormatServerStats(GetStats());
+      if (!WriteResponse(fd, kServerOk, stats.size()) ||
+          !WriteAll(fd, stats.data(), stats.size())) {
+        break;
+      }
+      continue;
+    }
+    size_t count = header[1];
+    if (header[0] == kImageMagic && header[1] <= kMaxRequestBytes) {
+      //  A BMP that can't be decoded leaves the stream in step
+      std::vector<uint8_t> bmp(header[1]);
+      if (!ReadAll(fd, bmp.data(), bmp.size())) {
+        break;
+      }
+      images.resize(kInputLayerNeurons);
+      try {
+        PreprocessImage(DecodeBmp(bmp.data(), bmp.size()), images.data());
+        count = 1;
+      } catch (const std::exception&) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          ++stats_.bad_requests;
+        }
+        if (!WriteResponse(fd, kServerBadRequest, 0)) {
+          break;
+        }
+        continue;
+      }
+    } else if (header[0] != kRequestMagic || header[1] > kMaxRequestImages) {
+      //  The rest of the stream can't be trusted
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.bad_requests;
+      }
+      WriteResponse(fd, kServerBadRequest, 0);
+      break;
+    } else {
+      images.resize(count * kInputLayerNeurons);
+      if (!ReadAll(fd, images.data(), images.size())) {
+        break;
+      }
+    }
+    predictions.resize(count);
+    Request request{images.data(), count, predictions.data(),
+                    std::chrono::steady_clock::now(), false};
+    server_status status = count ? Enqueue_(&request) : kServerOk;
+    if (!WriteResponse(fd, status, status == kServerOk ? count : 0) ||
+        (status == kServerOk &&
+         !WriteAll(fd, predictions.data(),
+                   count * sizeof(ServerPrediction)))) {
+      break;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  close(fd);
+  connection->finished = true;
+}
+
+server_status InferenceServer::Enqueue_(Request* request) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (request->count > options_.max_queue) {
+    ++stats_.bad_requests;
+    return kServerBadRequest;
+  }
+  if (stopping_ || queued_images_ + request->count > options_.max_queue) {
+    ++stats_.rejected;
+    return kServerOverloaded;
+  }
+  queue_.push_back(request);
+  queued_images_ += request->count;
+  stats_.max_queue_depth = std::max(stats_.max_queue_depth, queued_images_);
+  queued_.notify_one();
+  answered_.wait(lock, [request] { return request->done; });
+  return kServerOk;
+}
+
+void InferenceServer::Batch_() {
+  Tracer::GetInstance().SetThreadName("server batcher");
+  std::vector<Request*> batch;
+  uint64_t version = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    queued_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      break;
+    }
+    //  Waits for a full batch until the oldest request is max_wait_us old
+    auto deadline = queue_.front()->arrival +
+                    std::chrono::microseconds(options_.max_wait_us);
+    queued_.wait_until(lock, deadline, [this] {
+      return stopping_ || queued_images_ >= options_.max_batch;
+    });
+    size_t count = 0;
+    batch.clear();
+    while (!queue_.empty() &&
+           (batch.empty() ||
+            count + queue_.front()->count <= options_.max_batch)) {
+      batch.push_back(queue_.front());
+      count += queue_.front()->count;
+      queue_.pop_front();
+    }
+    queued_images_ -= count;
+    lock.unlock();
+    {
+      MLP_TRACE_SPAN("serve batch");
+      batch_images_.resize(count * kInputLayerNeurons);
+      batch_outputs_.resize(count * kOutputLayerNeurons);
+      uint8_t* images = batch_images_.data();
+      for (Request* it : batch) {
+        images = std::copy(it->images,
+                           it->images + it->count * kInputLayerNeurons, images);
+      }
+      if (snapshots_) {
+        SnapshotPin snapshot = snapshots_->Pin();
+        snapshot->PredictBatch(batch_images_.data(), count,
+                               batch_outputs_.data());
+        version = snapshot->GetVersion();
+      } else {
+        network_->PredictBatch(batch_images_.data(), count,
+                               batch_outputs_.data());
+      }
+      const double* outputs = batch_outputs_.data();
+      for (Request* it : batch) {
+        for (size_t i = 0; i < it->count; ++i) {
+          const double* best =
+              std::max_element(outputs, outputs + kOutputLayerNeurons);
+          it->predictions[i].label = best - outputs;
+          it->predictions[i].score = *best;
+          outputs += kOutputLayerNeurons;
+        }
+      }
+    }
+    auto now = std::chrono::steady_clock::now();
+    lock.lock();
+    for (Request* it : batch) {
+      double latency =
+          std::chrono::duration<double, std::micro>(now - it->arrival).count();
+      total_latency_us_ += latency;
+      stats_.max_latency_us = std::max(stats_.max_latency_us, latency);
+      it->done = true;
+    }
+    stats_.requests += batch.size();
+    stats_.images += count;
+    ++stats_.batches;
+    stats_.model_version = version;
+    answered_.notify_all();
+  }
+}
+
+InferenceClient::InferenceClient(const std::string& socket_path) {
+  sockaddr_un address = MakeAddress(socket_path);
+  fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr*>(&address),
+                         sizeof(address)) < 0) {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    throw std::invalid_argument("Error: can't connect to " + socket_path);
+  }
+}
+
+InferenceClient::~InferenceClient() { close(fd_); }
+
+void InferenceClient::ReadResponse_(uint32_t* status, uint32_t* count) {
+  uint32_t header[3];
+  if (!ReadAll(fd_, header, sizeof(header)) || header[0] != kResponseMagic) {
+    throw std::invalid_argument("Error: no response from the server");
+  }
+  *status = header[1];
+  *count = header[2];
+}
+
+server_status InferenceClient::Predict(
+    const uint8_t* images, size_t count,
+    std::vector<ServerPrediction>* predictions) {
+  if (count > kMaxRequestImages) {
+    throw std::out_of_range("Error: too many images in one request");
+  }
+  uint32_t header[2] = {kRequestMagic, static_cast<uint32_t>(count)};
+  //  A rejected connection is answered before the request is read, so a
+  //  failed write still has a response to read
+  if (WriteAll(fd_, header, sizeof(header))) {
+    WriteAll(fd_, images, count * kInputLayerNeurons);
+  }
+  return ReadPredictions_(predictions);
+}
+
+server_status InferenceClient::PredictBmp(
+    const uint8_t* data, size_t size,
+    std::vector<ServerPrediction>* predictions) {
+  if (size > kMaxRequestBytes) {
+    throw std::out_of_range("Error: too large image");
+  }
+  uint32_t header[2] = {kImageMagic, static_cast<uint32_t>(size)};
+  if (WriteAll(fd_, header, sizeof(header))) {
+    WriteAll(fd_, data, size);
+  }
+  return ReadPredictions_(predictions);
+}
+
+server_status InferenceClient::ReadPredictions_(
+    std::vector<ServerPrediction>* predictions) {
+  uint32_t status, size;
+  ReadResponse_(&status, &size);
+  predictions->resize(size);
+  if (!ReadAll(fd_, predictions->data(), size * sizeof(ServerPrediction))) {
+    throw std::invalid_argument("Error: no response from the server");
+  }
+  return static_cast<server_status>(status);
+}
+
+std::string InferenceClient::GetStats() {
+  uint32_t header[2] = {kStatsMagic, 0};
+  WriteAll(fd_, header, sizeof(header));
+  uint32_t status, size;
+  ReadResponse_(&status, &size);
+  std::string stats(size, '\0');
+  if (!ReadAll(fd_, &stats[0], size)) {
+    throw std::invalid_argument("Error: no response from the server");
+  }
+  return stats;
+}
+
+}  // namespace s21
@@ -0,0 +1,165 @@
+#ifndef SRC_SERVER_H_
+#define SRC_SERVER_H_
+
+#include <chrono>  // NOLINT(*)
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "network.h"
+#include "preprocess.h"
+#include "snapshot.h"
+
+namespace s21 {
+
+//  Wire protocol on a Unix domain socket, all fields uint32 in host order:
+//  request  kRequestMagic, count, count * kInputLayerNeurons pixels
+//  image    kImageMagic, size, size bytes of a BMP file (one image,
+//           preprocessed by the server)
+//  stats    kStatsMagic, 0
+//  response kResponseMagic, status, count, count * ServerPrediction
+//           (for stats: count bytes of JSON)
+const uint32_t kRequestMagic = 0x51504c4d;   // "MLPQ"
+const uint32_t kImageMagic = 0x42504c4d;     // "MLPB"
+const uint32_t kStatsMagic = 0x53504c4d;     // "MLPS"
+const uint32_t kResponseMagic = 0x52504c4d;  // "MLPR"
+const uint32_t kMaxRequestImages = 4096;
+const uint32_t kMaxRequestBytes = 16 << 20;
+const std::string kServerSocket = "/tmp/mlp.sock";
+
+typedef enum { kServerOk, kServerOverloaded, kServerBadRequest } server_status;
+
+struct ServerPrediction {
+  uint32_t label;  //  0-based letter
+  float score;     //  output of the winning neuron
+};
+
+//  A batch is run when max_batch images are waiting or the oldest request
+//  has waited max_wait_us. Requests that would make more than max_queue
+//  images wait are answered kServerOverloaded, connections above
+//  max_connections are answered so and closed. A request of more than
+//  max_queue images could never be admitted, it is answered
+//  kServerBadRequest; max_queue below kMaxRequestImages limits requests
+struct ServerOptions {
+  std::string socket_path = kServerSocket;
+  size_t max_batch = 32;
+  size_t max_wait_us = 1000;
+  size_t max_queue = 1024;
+  size_t max_connections = 64;
+};
+
+//  Latencies are from the arrival of a request to its batch being done
+struct ServerStats {
+  uint64_t requests;
+  uint64_t images;
+  uint64_t batches;
+  uint64_t rejected;
+  uint64_t bad_requests;
+  size_t connections;
+  size_t queue_depth;
+  size_t max_queue_depth;
+  double mean_batch;
+  double mean_latency_us;
+  double max_latency_us;
+  //  Snapshot version of the last batch, 0 when serving a network
+  uint64_t model_version;
+};
+
+std::string FormatServerStats(const ServerStats& stats);
+
+//  Answers predictions for local clients. Each connection has a thread that
+//  reads requests and waits for their results; one batcher thread groups
+//  the waiting requests and runs them through Network::PredictBatch, so the
+//  network must not be trained or reloaded while the server runs. Served
+//  from a SnapshotStore, every batch pins the latest published weights and
+//  training may go on meanwhile
+class InferenceServer {
+ public:
+  InferenceServer(Network* network, const ServerOptions& options);
+  //  A snapshot must have been published
+  InferenceServer(const SnapshotStore* snapshots,
+                  const ServerOptions& options);
+  InferenceServer(const InferenceServer&) = delete;
+  InferenceServer& operator=(const InferenceServer&) = delete;
+  ~InferenceServer() { Stop(); }
+
+  void Start();
+  //  Answers the requests already queued and closes every connection
+  void Stop();
+
+  ServerStats GetStats();
+
+ private:
+  struct Request {
+    const uint8_t* images;
+    size_t count;
+    ServerPrediction* predictions;
+    std::chrono::steady_clock::time_point arrival;
+    bool done;
+  };
+  struct Connection {
+    int fd;
+    bool finished;
+    std::thread thread;
+  };
+
+  Network* network_;
+  const SnapshotStore* snapshots_;
+  ServerOptions options_;
+  int listen_fd_;
+  int wake_fds_[2];
+  bool running_;
+  bool stopping_;
+  std::thread accept_thread_;
+  std::thread batch_thread_;
+  std::list<Connection> connections_;
+
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable answered_;
+  std::deque<Request*> queue_;
+  size_t queued_images_;
+  ServerStats stats_;
+  double total_latency_us_;
+  std::vector<uint8_t> batch_images_;
+  std::vector<double> batch_outputs_;
+
+  void Accept_();
+  void Serve_(Connection* connection);
+  void Batch_();
+  server_status Enqueue_(Request* request);
+  void ReapConnections_();
+};
+
+//  Blocking client of one connection
+class InferenceClient {
+ public:
+  explicit InferenceClient(const std::string& socket_path = kServerSocket);
+  InferenceClient(const InferenceClient&) = delete;
+  InferenceClient& operator=(const InferenceClient&) = delete;
+  ~InferenceClient();
+
+  server_status Predict(const uint8_t* images, size_t count,
+                        std::vector<ServerPrediction>* predictions);
+  //  One prediction for a BMP file, kServerBadRequest if it can't be
+  //  decoded
+  server_status PredictBmp(const uint8_t* data, size_t size,
+                           std::vector<ServerPrediction>* predictions);
+  std::string GetStats();
+
+ private:
+  int fd_;
+
+  void ReadResponse_(uint32_t* status, uint32_t* count);
+  server_status ReadPredictions_(std::vector<ServerPrediction>* predictions);
+};
+
+}  // namespace s21
+
+#endif  //  SRC_SERVER_H_
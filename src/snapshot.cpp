@@ -0,0 +1,199 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#include "threadpool.h"
+#include "tracer.h"
+
+namespace s21 {
+
+void DenseSigmoid(const double* inputs, size_t count, int rows,
+                  const double* weights, int cols, int ld, double* outputs) {
+  std::fill(outputs, outputs + count * cols, 0.0);
+  for (int k = 0; k < rows; ++k, weights += ld) {
+    for (size_t i = 0; i < count; ++i) {
+      double input = inputs[i * rows + k];
+      double* output = outputs + i * cols;
+      for (int j = 0; j < cols; ++j) {
+        output[j] += input * weights[j];
+      }
+    }
+  }
+  for (size_t i = 0; i < count * cols; ++i) {
+    outputs[i] = 1.0 / (1.0 + std::exp(-outputs[i]));
+  }
+}
+
+ConfusionCounts TestBatches(const DataSet& data, size_t max_tests,
+                            const BatchForward& forward) {
+  MetricsAccumulator metrics;
+  ThreadPool::GetDefault()->ParallelFor(
+      0, std::min(max_tests, data.GetSize()), kTestGrain,
+      [&](size_t first, size_t last) {
+        ConfusionCounts counts;
+        std::vector<uint8_t> images(kPredictGrain * kInputLayerNeurons);
+        std::vector<double> outputs(kPredictGrain * kOutputLayerNeurons);
+        for (size_t tile = first; tile < last; tile += kPredictGrain) {
+          size_t count = std::min(kPredictGrain, last - tile);
+          for (size_t i = 0; i < count; ++i) {
+            const uint8_t* image = data.GetImage(tile + i);
+            std::copy(image, image + kInputLayerNeurons,
+                      images.begin() + i * kInputLayerNeurons);
+          }
+          forward(images.data(), count, outputs.data());
+          for (size_t i = 0; i < count; ++i) {
+            const double* output = outputs.data() + i * kOutputLayerNeurons;
+            int label = data.GetLabel(tile + i) - 1, predicted = 0, rank = 0;
+            for (int j = 0; j < kOutputLayerNeurons; ++j) {
+              if (output[predicted] < output[j]) {
+                predicted = j;
+              }
+              if (output[label] < output[j]) {
+                ++rank;
+              }
+            }
+            counts.Add(label, predicted, rank);
+          }
+        }
+        metrics.Merge(counts);
+      });
+  return metrics.Snapshot();
+}
+
+WeightSnapshot::WeightSnapshot(uint64_t version, size_t num_layers,
+                               std::vector<double> weights)
+    : version_(version), num_layers_(num_layers), weights_(std::move(weights)) {
+  if (weights_.size() != CountWeights(num_layers_)) {
+    throw std::invalid_argument("Error: incorrect number of weights");
+  }
+}
+
+void WeightSnapshot::Forward(const uint8_t* image, double* outputs,
+                             InferenceWorkspace* workspace) const {
+  workspace->input.resize(kInputLayerNeurons);
+  workspace->output.resize(kHiddenLayerNeurons);
+  double* input = workspace->input.data();
+  double* output = workspace->output.data();
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    input[i] = static_cast<double>(image[i]) / 255.0;
+  }
+  const double* weights = weights_.data();
+  int rows = kInputLayerNeurons;
+  for (size_t layer = 0; layer < num_layers_; ++layer) {
+    int cols = layer + 1 == num_layers_ ? kOutputLayerNeurons
+                                        : kHiddenLayerNeurons;
+    DenseSigmoid(input, 1, rows, weights, cols, cols, output);
+    weights += rows * cols;
+    std::swap(input, output);
+    rows = cols;
+  }
+  std::copy(input, input + kOutputLayerNeurons, outputs);
+}
+
+int WeightSnapshot::Predict(const std::vector<int>& input_layer) const {
+  static thread_local InferenceWorkspace workspace;
+  if (input_layer.size() != kInputLayerNeurons) {
+    throw std::out_of_range("Error: incorrect size of the input layer");
+  }
+  workspace.image.resize(kInputLayerNeurons);
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    workspace.image[i] = std::clamp(input_layer[i], 0, 255);
+  }
+  workspace.result.resize(kOutputLayerNeurons);
+  double* outputs = workspace.result.data();
+  Forward(workspace.image.data(), outputs, &workspace);
+  return std::max_element(outputs, outputs + kOutputLayerNeurons) - outputs;
+}
+
+void WeightSnapshot::PredictBatch(const uint8_t* images, size_t count,
+                                  double* outputs) const {
+  ThreadPool::GetDefault()->ParallelFor(
+      0, count, kPredictGrain, [&](size_t first, size_t last) {
+        InferenceWorkspace workspace;
+        for (size_t i = first; i < last; ++i) {
+          Forward(images + i * kInputLayerNeurons,
+                  outputs + i * kOutputLayerNeurons, &workspace);
+        }
+      });
+}
+
+ConfusionCounts WeightSnapshot::Test(const DataSet& data,
+                                     size_t max_tests) const {
+  MLP_TRACE_SPAN("test snapshot");
+  return TestBatches(data, max_tests,
+                     [this](const uint8_t* images, size_t count,
+                            double* outputs) {
+                       InferenceWorkspace workspace;
+                       for (size_t i = 0; i < count; ++i) {
+                         Forward(images + i * kInputLayerNeurons,
+                                 outputs + i * kOutputLayerNeurons,
+                                 &workspace);
+                       }
+                     });
+}
+
+SnapshotStore::~SnapshotStore() { delete current_.load(); }
+
+uint64_t SnapshotStore::Publish(Network* network) {
+  MLP_TRACE_SPAN("publish snapshot");
+  std::vector<double> weights;
+  network->GetWeights(&weights);
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  uint64_t version = version_.load() + 1;
+  auto snapshot = std::make_unique<const WeightSnapshot>(
+      version, network->GetNumLayers(), std::move(weights));
+  const WeightSnapshot* old = current_.exchange(snapshot.release());
+  version_.store(version);
+  if (old) {
+    retired_.push_back(
+        Retired{std::unique_ptr<const WeightSnapshot>(old), epoch_++});
+  }
+  Reclaim_();
+  return version;
+}
+
+SnapshotPin SnapshotStore::Pin() const {
+  size_t first = std::hash<std::thread::id>()(std::this_thread::get_id());
+  for (;;) {
+    for (size_t i = 0; i < kSnapshotSlots; ++i) {
+      std::atomic<uint64_t>& slot = slots_[(first + i) % kSnapshotSlots].epoch;
+      uint64_t free = 0;
+      //  The slot is marked before the pointer is loaded (both seq_cst)
+      if (slot.load(std::memory_order_relaxed) == 0 &&
+          slot.compare_exchange_strong(free, epoch_.load())) {
+        return SnapshotPin(&slot, current_.load());
+      }
+    }
+    std::this_thread::yield();
+  }
+}
+
+size_t SnapshotStore::GetNumRetired() {
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  Reclaim_();
+  return retired_.size();
+}
+
+void SnapshotStore::Reclaim_() {
+  if (retired_.empty()) {
+    return;
+  }
+  uint64_t oldest = UINT64_MAX;
+  for (auto& it : slots_) {
+    uint64_t epoch = it.epoch.load();
+    if (epoch) {
+      oldest = std::min(oldest, epoch);
+    }
+  }
+  retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                [oldest](const Retired& it) {
+                                  return it.epoch < oldest;
+                                }),
+                 retired_.end());
+}
+
+}  // namespace s21
@@ -0,0 +1,141 @@
+#ifndef SRC_SNAPSHOT_H_
+#define SRC_SNAPSHOT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "network.h"
+
+namespace s21 {
+
+//  Readers pinned at once, more wait for a free slot
+const size_t kSnapshotSlots = 64;
+//  Training batches between two published snapshots
+const size_t kSnapshotBatches = 5;
+//  Samples of one WeightSnapshot::Test task on the thread pool
+const size_t kTestGrain = 256;
+
+//  count rows of inputs (rows values each) through a dense sigmoid layer
+//  into outputs (cols values each). weights is rows x cols with a row
+//  stride of ld; each weight row serves every input row before the next,
+//  the sums keep the order of Matrix::MulMatrixWithSigmoid
+void DenseSigmoid(const double* inputs, size_t count, int rows,
+                  const double* weights, int cols, int ld, double* outputs);
+
+//  Confusion counts of the first max_tests samples of data, forward gives
+//  the output layers of up to kPredictGrain images at once. Chunks of
+//  kTestGrain samples run on the default thread pool
+typedef std::function<void(const uint8_t* images, size_t count,
+                           double* outputs)>
+    BatchForward;
+ConfusionCounts TestBatches(const DataSet& data, size_t max_tests,
+                            const BatchForward& forward);
+
+//  Immutable copy of the weights of a network (in the order of GetWeights),
+//  safe to use from any number of threads
+class WeightSnapshot {
+ public:
+  WeightSnapshot(uint64_t version, size_t num_layers,
+                 std::vector<double> weights);
+
+  uint64_t GetVersion() const { return version_; }
+  size_t GetNumLayers() const { return num_layers_; }
+  const std::vector<double>& GetWeights() const { return weights_; }
+
+  //  Like Network::Forward, the same values as MatrixNetwork gives
+  void Forward(const uint8_t* image, double* outputs,
+               InferenceWorkspace* workspace) const;
+  //  Like Network::Predict, with the workspace of the calling thread
+  int Predict(const std::vector<int>& input_layer) const;
+  //  Like Network::PredictBatch, chunks run on the default thread pool
+  void PredictBatch(const uint8_t* images, size_t count,
+                    double* outputs) const;
+  //  Confusion counts of the first max_tests samples of data, like a test
+  //  pass of Network but on the default thread pool
+  ConfusionCounts Test(const DataSet& data, size_t max_tests) const;
+
+ private:
+  uint64_t version_;
+  size_t num_layers_;
+  std::vector<double> weights_;
+};
+
+class SnapshotStore;
+
+//  Keeps the snapshot it was taken with alive until it is destroyed
+class SnapshotPin {
+ public:
+  SnapshotPin(SnapshotPin&& other)
+      : slot_(other.slot_), snapshot_(other.snapshot_) {
+    other.slot_ = nullptr;
+  }
+  SnapshotPin(const SnapshotPin&) = delete;
+  SnapshotPin& operator=(const SnapshotPin&) = delete;
+  ~SnapshotPin() {
+    if (slot_) {
+      slot_->store(0, std::memory_order_release);
+    }
+  }
+
+  //  nullptr before the first snapshot is published
+  const WeightSnapshot* Get() const { return snapshot_; }
+  const WeightSnapshot* operator->() const { return snapshot_; }
+  explicit operator bool() const { return snapshot_ != nullptr; }
+
+ private:
+  friend class SnapshotStore;
+  SnapshotPin(std::atomic<uint64_t>* slot, const WeightSnapshot* snapshot)
+      : slot_(slot), snapshot_(snapshot) {}
+
+  std::atomic<uint64_t>* slot_;
+  const WeightSnapshot* snapshot_;
+};
+
+//  The latest published weights, read without locks (RCU). A reader marks
+//  a slot with the current epoch and loads the snapshot pointer; Publish
+//  swaps the pointer, retires the old snapshot with the epoch of the swap
+//  and advances the epoch. A retired snapshot is deleted once every slot
+//  is free or marked after its epoch, as those readers load a newer one
+class SnapshotStore {
+ public:
+  SnapshotStore() : current_(nullptr), epoch_(1), version_(0) {}
+  SnapshotStore(const SnapshotStore&) = delete;
+  SnapshotStore& operator=(const SnapshotStore&) = delete;
+  //  No reader may be pinned any more
+  ~SnapshotStore();
+
+  //  Copies the weights of network as the next version and returns it;
+  //  publishers take a mutex among themselves, readers are never blocked
+  uint64_t Publish(Network* network);
+  SnapshotPin Pin() const;
+
+  uint64_t GetVersion() const { return version_.load(); }
+  //  Snapshots replaced but still pinned by some reader
+  size_t GetNumRetired();
+
+ private:
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{0};
+  };
+  struct Retired {
+    std::unique_ptr<const WeightSnapshot> snapshot;
+    uint64_t epoch;
+  };
+
+  std::atomic<const WeightSnapshot*> current_;
+  std::atomic<uint64_t> epoch_;
+  std::atomic<uint64_t> version_;
+  mutable Slot slots_[kSnapshotSlots];
+  std::mutex publish_mutex_;
+  std::vector<Retired> retired_;
+
+  void Reclaim_();
+};
+
+}  // namespace s21
+
+#endif  //  SRC_SNAPSHOT_H_
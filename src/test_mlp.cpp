@@ -1,13 +1,129 @@
 #include <gtest/gtest.h>
+#include <zlib.h>
+#ifdef MLP_WITH_ZSTD
+#include <zstd.h>
+#endif
 
+#include <filesystem>
+#include <future>  // NOLINT(*)
+#include <sstream>
+#include <thread>  // NOLINT(*)
+
+#include "checkpoint.h"
+#include "crossvalidation.h"
+#include "dataloader.h"
+#include "dataset.h"
+#include "decompressor.h"
+#include "ensemble.h"
 #include "graphnetwork.h"
+#include "imagebatch.h"
+#include "jobrunner.h"
+#include "livepredictor.h"
 #include "matrix.h"
 #include "matrixnetwork.h"
+#include "metrics.h"
+#include "modelregistry.h"
+#include "preprocess.h"
+#include "server.h"
+#include "snapshot.h"
+#include "threadpool.h"
+#include "tracer.h"
 
 namespace s21 {
 
 const std::string kWeightsFileLoad = "./weights/weights_2_784_86__.txt";
 const std::string kWeightsFileSave = "./weights/weights_2_784_test.txt";
+const std::string kDataSetFileCsv = "./datasets/23.csv";
+const std::string kDataSetFileTest = "./datasets/emnist-letters-tmp.csv";
+const std::string kCheckpointFileTest = "./weights/checkpoint_test.bin";
+const std::string kDataSetFileBin = "./datasets/emnist-letters-tmp.bin";
+const std::string kDataSetFileGz = "./datasets/emnist-letters-tmp.csv.gz";
+const std::string kDataSetFileZst = "./datasets/emnist-letters-tmp.csv.zst";
+const std::string kTraceFileTest = "./datasets/mlp-trace-tmp.json";
+const std::string kServerSocketTest = "./datasets/mlp-tmp.sock";
+const std::string kDataSetFileIdx = "./datasets/emnist-tmp-images-idx3-ubyte";
+const std::string kDataSetFileIdxLabels =
+    "./datasets/emnist-tmp-labels-idx1-ubyte";
+const std::string kImageDirTest = "./datasets/images-tmp";
+
+void WriteDataSetFileTest() {
+  std::ifstream fp(kDataSetFileCsv);
+  std::string line;
+  std::getline(fp, line);
+  std::ofstream out(kDataSetFileTest);
+  out << line << std::endl;
+  out << "1";
+  for (int i = 0; i < kInputLayerNeurons; ++i) {
+    out << "," << i % 256;
+  }
+  out << std::endl << line << std::endl;
+}
+
+//  Uncompressed BMP of 1, 24 or 32 bits per pixel showing ink (255 - gray)
+std::vector<uint8_t> EncodeBmpTest(const std::vector<uint8_t>& ink, int width,
+                                   int height, int bits, bool top_down) {
+  size_t stride = (width * bits + 31) / 32 * 4;
+  size_t offset = 54 + (bits == 1 ? 8 : 0);
+  std::vector<uint8_t> bmp(offset + stride * height);
+  auto put = [&bmp](size_t pos, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      bmp[pos + i] = value >> (8 * i);
+    }
+  };
+  bmp[0] = 'B';
+  bmp[1] = 'M';
+  put(2, bmp.size());
+  put(10, offset);
+  put(14, 40);
+  put(18, width);
+  put(22, top_down ? -height : height);
+  put(26, 1 | bits << 16);
+  if (bits == 1) {
+    put(58, 0xffffff);
+  }
+  for (int y = 0; y < height; ++y) {
+    uint8_t* row = &bmp[offset + (top_down ? y : height - 1 - y) * stride];
+    for (int x = 0; x < width; ++x) {
+      uint8_t gray = 255 - ink[y * width + x];
+      if (bits == 1) {
+        row[x / 8] |= (gray > 127) << (7 - x % 8);
+      } else {
+        std::fill(row + x * bits / 8, row + x * bits / 8 + 3, gray);
+      }
+    }
+  }
+  return bmp;
+}
+
+void WriteDataSetFileGzTest() {
+  WriteDataSetFileTest();
+  std::ifstream fp(kDataSetFileTest);
+  std::string data((std::istreambuf_iterator<char>(fp)),
+                   std::istreambuf_iterator<char>());
+  gzFile out = gzopen(kDataSetFileGz.c_str(), "wb");
+  gzwrite(out, data.data(), data.size());
+  gzclose(out);
+}
+
+//  Holds the jobs that read it until the gate opens
+class GatedDataSet : public DataSet {
+ public:
+  GatedDataSet(const DataSet& data, std::shared_future<void> gate)
+      : data_(data), gate_(std::move(gate)) {}
+
+  size_t GetSize() const override {
+    gate_.wait();
+    return data_.GetSize();
+  }
+  int GetLabel(size_t index) const override { return data_.GetLabel(index); }
+  const uint8_t* GetImage(size_t index) const override {
+    return data_.GetImage(index);
+  }
+
+ private:
+  const DataSet& data_;
+  std::shared_future<void> gate_;
+};
 
 }  // namespace s21
 
@@ -98,7 +214,1168 @@ TEST(Network, Statistic) {
   mn.CalculateFmeasure();
   std::string line = "1,0,3,0,33,0,0,0,255,14,0,0,0,0,12,0,0";
   ASSERT_THROW(mn.ReadEmnistLetter(line), std::length_error);
+
+  //  Labels and pixels out of range are refused before the metrics see them
+  std::ifstream fp(s21::kDataSetFileCsv);
+  std::getline(fp, line);
+  std::string pixels = line.substr(line.find(','));
+  for (std::string label : {"0", "27"}) {
+    std::istringstream stream(label + pixels + "\n");
+    size_t count = 1;
+    ASSERT_THROW(mn.TestNetwork(stream, count, 10), std::invalid_argument);
+  }
+  pixels = pixels.substr(pixels.find(',', 1));
+  ASSERT_THROW(mn.ReadEmnistLetter("1,256" + pixels), std::invalid_argument);
+}
+
+TEST(Metrics, Compute) {
+  s21::ConfusionCounts counts;
+  counts.Add(0, 0, 0);
+  counts.Add(0, 1, 1);
+  counts.Add(1, 1, 0);
+  s21::ConfusionCounts other;
+  other.Add(1, 0, 3);
+  counts.Merge(other);
+
+  s21::MetricsAccumulator accumulator;
+  accumulator.Merge(counts);
+  s21::MetricsReport report = s21::ComputeMetrics(accumulator.Snapshot());
+  ASSERT_EQ(report.total, 4);
+  ASSERT_EQ(report.errors, 2);
+  ASSERT_NEAR(report.accuracy, 0.5, kEPS);
+  ASSERT_NEAR(report.macro_precision, 0.5, kEPS);
+  ASSERT_NEAR(report.macro_recall, 0.5, kEPS);
+  ASSERT_NEAR(report.micro_fmeasure, 0.5, kEPS);
+  ASSERT_NEAR(report.top_k[0], 0.5, kEPS);
+  ASSERT_NEAR(report.top_k[1], 0.75, kEPS);
+  ASSERT_NEAR(report.top_k[3], 1, kEPS);
+  ASSERT_EQ(report.classes[1].support, 2);
+  ASSERT_EQ(report.classes[1].predicted, 2);
+  ASSERT_EQ(report.classes[2].support, 0);
+  ASSERT_NE(s21::FormatClassMetrics(report).find("\nZ "), std::string::npos);
+  accumulator.Reset();
+  ASSERT_EQ(s21::ComputeMetrics(accumulator.Snapshot()).accuracy, 0);
+
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::ifstream fp(s21::kDataSetFileCsv);
+  size_t count = 1;
+  mn.TestNetwork(fp, count, s21::kNumDataSetTests);
+  report = mn.GetMetrics();
+  ASSERT_EQ(report.total, count - 1);
+  ASSERT_EQ(report.errors, mn.GetCountErrors());
+  ASSERT_GE(report.top_k[4], report.top_k[0]);
+  ASSERT_NEAR(report.top_k[0], report.accuracy, kEPS);
+  ASSERT_NEAR(report.top_k.back(), 1, kEPS);
+}
+
+TEST(Profiler, Report) {
+  s21::Profiler profiler;
+  profiler.AddTime(s21::kPhaseForward, 2000000000);
+  profiler.AddTime(s21::kPhaseUi, 1000000000);
+  profiler.AddSamples(10);
+  profiler.AddAllocation(100);
+  profiler.AddAllocation(50);
+  profiler.AddFree(100);
+  profiler.AddAllocation(20);
+  s21::ProfileReport report = profiler.GetReport();
+  ASSERT_EQ(report.phases[s21::kPhaseForward].calls, 1);
+  ASSERT_NEAR(report.phases[s21::kPhaseForward].time, 2, kEPS);
+  ASSERT_NEAR(report.samples_per_second, 5, kEPS);
+  ASSERT_EQ(report.allocations, 3);
+  ASSERT_EQ(report.peak_workspace, 150);
+  ASSERT_NE(s21::FormatProfile(report).find("forward"), std::string::npos);
+
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::ifstream fp(s21::kDataSetFileCsv);
+  size_t count = 1;
+  mn.TrainNetwork(fp, count, 0, 0);
+  report = mn.GetProfiler()->GetReport();
+  if (s21::kProfileEnabled) {
+    ASSERT_EQ(report.samples, 1);
+    ASSERT_EQ(report.phases[s21::kPhaseBackward].calls, 1);
+    ASSERT_GT(report.bytes_read, s21::kInputLayerNeurons);
+    ASSERT_GT(report.peak_workspace, 0);
+  } else {
+    ASSERT_EQ(report.samples, 0);
+    ASSERT_EQ(report.phases[s21::kPhaseForward].calls, 0);
+  }
+  ASSERT_EQ(s21::Profiler::Current(), nullptr);
+}
+
+TEST(Tracer, Dump) {
+  s21::Tracer& tracer = s21::Tracer::GetInstance();
+  { MLP_TRACE_SPAN("before start"); }
+  tracer.Start(4);
+  tracer.SetThreadName("test \"main\"");
+  for (int i = 0; i < 6; ++i) {
+    MLP_TRACE_SPAN(i < 2 ? "dropped" : "kept");
+  }
+  std::thread([] {
+    s21::Tracer::GetInstance().SetThreadName("worker");
+    MLP_TRACE_SPAN("worker span");
+  }).join();
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::ifstream fp(s21::kDataSetFileCsv);
+  size_t count = 1;
+  mn.TestNetwork(fp, count, s21::kNumDataSetTests);
+  tracer.Stop();
+  { MLP_TRACE_SPAN("after stop"); }
+  tracer.Dump(s21::kTraceFileTest);
+
+  std::ifstream trace(s21::kTraceFileTest);
+  std::string json((std::istreambuf_iterator<char>(trace)),
+                   std::istreambuf_iterator<char>());
+  ASSERT_EQ(json.find("before start"), std::string::npos);
+  ASSERT_EQ(json.find("after stop"), std::string::npos);
+  ASSERT_NE(json.find("\"kept\""), std::string::npos);
+  ASSERT_NE(json.find("worker span"), std::string::npos);
+  ASSERT_NE(json.find("test \\\"main\\\""), std::string::npos);
+  //  The main thread ring holds 4 spans: test batch, its parse and forward
+  //  and the last "kept"
+  ASSERT_EQ(json.find("dropped"), std::string::npos);
+  ASSERT_NE(json.find("\"forward\""), std::string::npos);
+  ASSERT_NE(json.find("\"test batch\""), std::string::npos);
+
+  //  A ring grows past its first size up to the limit, losing nothing
+  tracer.Start(3000);
+  for (int i = 0; i < 2500; ++i) {
+    MLP_TRACE_SPAN("grown");
+  }
+  tracer.Stop();
+  tracer.Dump(s21::kTraceFileTest);
+  std::ifstream grown(s21::kTraceFileTest);
+  json.assign(std::istreambuf_iterator<char>(grown),
+              std::istreambuf_iterator<char>());
+  size_t num_spans = 0;
+  for (size_t pos = json.find("\"grown\""); pos != std::string::npos;
+       pos = json.find("\"grown\"", pos + 1)) {
+    ++num_spans;
+  }
+  ASSERT_EQ(num_spans, 2500);
+  std::remove(s21::kTraceFileTest.c_str());
+}
+
+TEST(DataSet, Parse) {
+  std::ifstream fp(s21::kDataSetFileCsv);
+  std::string line;
+  std::getline(fp, line);
+  int letter[s21::kInputLayerNeurons + 1];
+  s21::ParseEmnistLetter(line + "\r", letter);
+  ASSERT_EQ(letter[0], 23);
+
+  s21::MatrixNetwork mn;
+  mn.ReadEmnistLetter(line);
+  ASSERT_EQ(mn.GetEmnistLetter().size(), s21::kInputLayerNeurons + 1);
+  ASSERT_EQ(mn.GetEmnistLetter()[0], 23);
+  ASSERT_THROW(mn.ReadEmnistLetter(line + ",0"), std::length_error);
+  ASSERT_THROW(mn.ReadEmnistLetter("23,0,x,0"), std::invalid_argument);
+  try {
+    s21::ParseEmnistLetter("23,0,1;0", letter);
+    FAIL();
+  } catch (const std::invalid_argument& e) {
+    ASSERT_NE(std::string(e.what()).find("position 6"), std::string::npos);
+  }
+}
+
+TEST(DataSet, Convert) {
+  s21::WriteDataSetFileTest();
+  ASSERT_EQ(s21::ConvertDataSet(s21::kDataSetFileTest, s21::kDataSetFileBin),
+            3);
+  s21::BinaryDataSet data(s21::kDataSetFileBin);
+  ASSERT_EQ(data.GetSize(), 3);
+  ASSERT_EQ(data.GetLabel(0), 23);
+  ASSERT_EQ(data.GetLabel(1), 1);
+  ASSERT_EQ(data.GetImage(1)[0], 0);
+  ASSERT_EQ(data.GetImage(1)[300], 300 % 256);
+  ASSERT_EQ(data.GetImage(2)[783], data.GetImage(0)[783]);
+
+  //  A cache with a label out of 1..26 is refused
+  {
+    std::fstream bin(s21::kDataSetFileBin,
+                     std::ios::in | std::ios::out | std::ios::binary);
+    bin.seekp(sizeof(s21::DataSetHeader) + s21::kInputLayerNeurons + 1);
+    bin.put(27);
+  }
+  ASSERT_THROW(s21::BinaryDataSet corrupt(s21::kDataSetFileBin),
+               std::invalid_argument);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(DataSet, Incorrect) {
+  std::ofstream(s21::kDataSetFileTest) << "1,0,3,0,33" << std::endl;
+  ASSERT_THROW(s21::OpenDataSet(s21::kDataSetFileTest), std::length_error);
+  ASSERT_THROW(s21::BinaryDataSet data(s21::kDataSetFileTest),
+               std::invalid_argument);
+  std::remove(s21::kDataSetFileTest.c_str());
+}
+
+TEST(DataSet, Idx) {
+  const unsigned char images_header[] = {0, 0, 8, 3, 0, 0, 0, 2,
+                                         0, 0, 0, 28, 0, 0, 0, 28};
+  const unsigned char labels_header[] = {0, 0, 8, 1, 0, 0, 0, 2, 26, 1};
+  std::ofstream images(s21::kDataSetFileIdx, std::ios::binary);
+  images.write(reinterpret_cast<const char*>(images_header), 16);
+  for (int i = 0; i < 2 * s21::kInputLayerNeurons; ++i) {
+    images.put(static_cast<char>(i % 251));
+  }
+  images.close();
+  std::ofstream(s21::kDataSetFileIdxLabels, std::ios::binary)
+      .write(reinterpret_cast<const char*>(labels_header), 10);
+
+  auto data = s21::OpenDataSet(s21::kDataSetFileIdx);
+  ASSERT_EQ(data->GetSize(), 2);
+  ASSERT_EQ(data->GetLabel(0), 26);
+  ASSERT_EQ(data->GetLabel(1), 1);
+  ASSERT_EQ(data->GetImage(1)[0], s21::kInputLayerNeurons % 251);
+  ASSERT_THROW(
+      s21::IdxDataSet(s21::kDataSetFileIdxLabels, s21::kDataSetFileIdx),
+      std::invalid_argument);
+  std::remove(s21::kDataSetFileIdx.c_str());
+  std::remove(s21::kDataSetFileIdxLabels.c_str());
+}
+
+TEST(DataSet, TestNetwork) {
+  s21::WriteDataSetFileTest();
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::ifstream fp(s21::kDataSetFileTest);
+  size_t count = 1;
+  mn.TestNetwork(fp, count, s21::kNumDataSetTests);
+  size_t errors = mn.GetCountErrors();
+  double accuracy = mn.CalculateAccuracy();
+
+  mn.ResetStatistics();
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  size_t count_data = 1;
+  ASSERT_FALSE(mn.TestNetwork(*data, count_data, s21::kNumDataSetTests));
+  ASSERT_EQ(count_data - 1, 3);
+  ASSERT_EQ(mn.GetCountErrors(), errors);
+  ASSERT_NEAR(mn.CalculateAccuracy(), accuracy, kEPS);
+  //  Ends at max_tests without the caller checking count
+  count_data = 1;
+  ASSERT_FALSE(mn.TestNetwork(*data, count_data, 2));
+  ASSERT_EQ(count_data - 1, 2);
+
+  count_data = 1;
+  ASSERT_FALSE(mn.TrainNetwork(*data, count_data, 0, 0));
+  ASSERT_EQ(count_data - 1, 3);
+  ASSERT_EQ(mn.GetTrainingCurve().GetBatches().size(), 1);
+  ASSERT_EQ(mn.GetTrainingCurve().GetBatches()[0].samples, 3);
+  ASSERT_TRUE(mn.GetTrainingCurve().GetEpochs().empty());
+  mn.FinishTrainingEpoch();
+  s21::TrainingPoint epoch = mn.GetTrainingCurve().GetEpochs().at(0);
+  ASSERT_EQ(epoch.samples, 3);
+  ASSERT_NEAR(epoch.accuracy, accuracy, kEPS);
+  ASSERT_GT(epoch.loss, 0);
+  ASSERT_LT(epoch.loss, s21::kOutputLayerNeurons / 2.0);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(DataSet, PredictBatch) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  std::vector<uint8_t> images;
+  for (size_t i = 0; i < data->GetSize(); ++i) {
+    images.insert(images.end(), data->GetImage(i),
+                  data->GetImage(i) + s21::kInputLayerNeurons);
+  }
+  s21::MatrixNetwork mn;
+  s21::GraphNetwork gn;
+  std::vector<s21::Network*> networks = {&mn, &gn};
+  std::vector<double> outputs(data->GetSize() * s21::kOutputLayerNeurons);
+  for (s21::Network* net : networks) {
+    net->LoadWeights(s21::kWeightsFileLoad);
+    net->PredictBatch(images.data(), data->GetSize(), outputs.data());
+    for (size_t i = 0; i < data->GetSize(); ++i) {
+      std::vector<int> input_layer(data->GetImage(i),
+                                   data->GetImage(i) + s21::kInputLayerNeurons);
+      const double* output = &outputs[i * s21::kOutputLayerNeurons];
+      ASSERT_EQ(std::max_element(output, output + s21::kOutputLayerNeurons) -
+                    output,
+                net->Predict(input_layer));
+    }
+  }
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(Network, SharedForward) {
+  //  Threads with their own workspaces share one read-only network
+  std::vector<uint8_t> images(64 * s21::kInputLayerNeurons);
+  for (size_t i = 0; i < images.size(); ++i) {
+    images[i] = (i * 31 + i / 97) % 256;
+  }
+  s21::MatrixNetwork mn;
+  s21::GraphNetwork gn;
+  std::vector<s21::Network*> networks = {&mn, &gn};
+  for (s21::Network* net : networks) {
+    net->LoadWeights(s21::kWeightsFileLoad);
+    std::vector<double> expected(64 * s21::kOutputLayerNeurons);
+    net->PredictBatch(images.data(), 64, expected.data());
+    std::vector<std::vector<double>> outputs(
+        4, std::vector<double>(expected.size()));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < outputs.size(); ++t) {
+      threads.emplace_back([&, t] {
+        s21::InferenceWorkspace workspace;
+        for (size_t i = 0; i < 64; ++i) {
+          net->Forward(&images[i * s21::kInputLayerNeurons],
+                       &outputs[t][i * s21::kOutputLayerNeurons], &workspace);
+        }
+      });
+    }
+    for (auto& it : threads) {
+      it.join();
+    }
+    for (auto& it : outputs) {
+      ASSERT_EQ(it, expected);
+    }
+  }
+  ASSERT_THROW(mn.Predict(std::vector<int>(3)), std::out_of_range);
+}
+
+TEST(DataSet, Shuffle) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::LoadDataSet(s21::kDataSetFileTest);
+  ASSERT_EQ(data->GetSize(), 3);
+  ASSERT_EQ(data->GetLabel(1), 1);
+  ASSERT_EQ(data->GetImage(1)[300], 300 % 256);
+
+  std::vector<size_t> order = s21::ShuffleIndices(100, s21::kShuffleSeed);
+  ASSERT_EQ(order, s21::ShuffleIndices(100, s21::kShuffleSeed));
+  ASSERT_NE(order, s21::ShuffleIndices(100, s21::kShuffleSeed + 1));
+  std::vector<size_t> sorted = order;
+  std::sort(sorted.begin(), sorted.end());
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    ASSERT_EQ(sorted[i], i);
+  }
+
+  s21::DataSetView view(*data, {1, 0});
+  ASSERT_EQ(view.GetSize(), 2);
+  ASSERT_EQ(view.GetLabel(0), 1);
+  ASSERT_EQ(view.GetImage(1), data->GetImage(0));
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(DataSet, Fold) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::LoadDataSet(s21::kDataSetFileTest);
+  s21::Fold fold = s21::MakeFold(*data, 3, 1);
+  ASSERT_EQ(fold.train.GetIndices(), std::vector<size_t>({0, 2}));
+  ASSERT_EQ(fold.validation.GetIndices(), std::vector<size_t>({1}));
+  ASSERT_EQ(fold.validation.GetLabel(0), 1);
+  ASSERT_EQ(fold.train.GetLabel(1), 23);
+  ASSERT_THROW(s21::MakeFold(*data, 3, 3), std::out_of_range);
+
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  size_t count = 1;
+  ASSERT_FALSE(mn.TestNetwork(fold.validation, count, s21::kNumDataSetTests));
+  ASSERT_EQ(count - 1, 1);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(CrossValidation, Run) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::LoadDataSet(s21::kDataSetFileTest);
+  s21::CrossValidationOptions options;
+  options.type = s21::kGraphNet;
+  options.num_folds = 3;
+  options.num_threads = 2;
+  std::vector<s21::FoldResult> folds = s21::RunCrossValidation(*data, options);
+  ASSERT_EQ(folds.size(), 3);
+  for (size_t i = 0; i < folds.size(); ++i) {
+    ASSERT_EQ(folds[i].fold, i);
+    ASSERT_EQ(folds[i].num_tests, 1);
+    ASSERT_NEAR(folds[i].accuracy, 1.0 - folds[i].num_errors, kEPS);
+  }
+  s21::FoldResult mean = s21::AverageFolds(folds);
+  ASSERT_EQ(mean.fold, 3);
+  ASSERT_EQ(mean.num_tests, 3);
+  ASSERT_EQ(mean.time, std::max({folds[0].time, folds[1].time,
+                                 folds[2].time}));
+  //  The folds are seeded from options.seed, so a second run repeats them
+  std::vector<s21::FoldResult> again = s21::RunCrossValidation(*data, options);
+  for (size_t i = 0; i < folds.size(); ++i) {
+    ASSERT_EQ(again[i].num_errors, folds[i].num_errors);
+    for (int rank = 0; rank < s21::kNumClasses; ++rank) {
+      ASSERT_EQ(again[i].counts.GetRankCount(rank),
+                folds[i].counts.GetRankCount(rank));
+    }
+  }
+  options.num_folds = 4;
+  ASSERT_THROW(s21::RunCrossValidation(*data, options), std::out_of_range);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(DataLoader, Order) {
+  s21::WriteDataSetFileTest();
+  s21::DataLoader loader(s21::kDataSetFileTest, 2, 1, 1);
+  std::vector<int> labels;
+  while (const s21::SampleBatch* batch = loader.Next()) {
+    ASSERT_EQ(batch->GetSize(), 1);
+    ASSERT_EQ(batch->GetIndex(0), labels.size() + 1);
+    labels.push_back(batch->GetLabel(0));
+  }
+  ASSERT_EQ(labels, std::vector<int>({23, 1, 23}));
+  ASSERT_EQ(loader.Next(), nullptr);
+  s21::LoaderStats stats = loader.GetStats();
+  ASSERT_EQ(stats.batches, 3);
+  ASSERT_EQ(stats.queue_depth, 0);
+
+  //  Uneven batches with blank lines: line numbers of the file, in order
+  std::ofstream out(s21::kDataSetFileTest);
+  for (int i = 0; i < 250; ++i) {
+    if (i % 17 == 0) {
+      out << std::endl;
+      continue;
+    }
+    out << i % 26 + 1;
+    for (int j = 0; j < s21::kInputLayerNeurons; ++j) {
+      out << "," << (i + j) % 256;
+    }
+    out << std::endl;
+  }
+  out.close();
+  for (size_t num_readers : {1, 3, 4}) {
+    s21::DataLoader lines(s21::kDataSetFileTest, num_readers, 2, 7);
+    size_t expected = 1;
+    while (const s21::SampleBatch* batch = lines.Next()) {
+      for (size_t i = 0; i < batch->GetSize(); ++i, ++expected) {
+        expected += (expected - 1) % 17 == 0;
+        ASSERT_EQ(batch->GetIndex(i), expected);
+        ASSERT_EQ(batch->GetLabel(i), (expected - 1) % 26 + 1);
+        ASSERT_EQ(batch->GetImage(i)[1], expected % 256);
+      }
+    }
+    ASSERT_EQ(expected, 251);
+  }
+  std::remove(s21::kDataSetFileTest.c_str());
+}
+
+TEST(JobRunner, Train) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  s21::JobRunner jobs;
+  jobs.StartTraining(&mn, *data, data.get(), 2);
+  ASSERT_THROW(jobs.StartTesting(&mn, *data, 1), std::invalid_argument);
+  jobs.Wait();
+  s21::JobProgress progress = jobs.GetProgress();
+  ASSERT_EQ(progress.state, s21::kJobFinished);
+  ASSERT_EQ(progress.pass, s21::kPassTest);
+  ASSERT_EQ(progress.epoch, 2);
+  ASSERT_EQ(progress.samples, 3);
+  ASSERT_EQ(jobs.GetEpochResults().size(), 2);
+  ASSERT_GE(jobs.GetEpochResults()[1].test_accuracy, 0);
+  ASSERT_EQ(mn.GetTrainingCurve().GetEpochs().size(), 2);
+
+  //  A long epoch is paused before it begins (its data holds the job until
+  //  then) and cancelled
+  s21::SampleBatch large;
+  std::vector<int> letter(s21::kInputLayerNeurons + 1, 1);
+  for (size_t i = 0; i < 20 * s21::kDataSetBatchSize; ++i) {
+    large.Add(i + 1, letter.data());
+  }
+  std::promise<void> gate;
+  s21::GatedDataSet gated(large, gate.get_future().share());
+  jobs.StartTraining(&mn, gated, nullptr, 1);
+  jobs.Pause();
+  gate.set_value();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  progress = jobs.GetProgress();
+  ASSERT_EQ(progress.state, s21::kJobPaused);
+  ASSERT_EQ(progress.samples, 0);
+  jobs.Cancel();
+  jobs.Wait();
+  ASSERT_EQ(jobs.GetProgress().state, s21::kJobCancelled);
+  ASSERT_TRUE(jobs.GetEpochResults().empty());
+  std::remove(s21::kDataSetFileTest.c_str());
+}
+
+TEST(Checkpoint, Resume) {
+  s21::SampleBatch data;
+  std::vector<int> letter(s21::kInputLayerNeurons + 1);
+  for (size_t i = 0; i < 40; ++i) {
+    letter[0] = 1 + i % s21::kNumClasses;
+    for (int j = 1; j <= s21::kInputLayerNeurons; ++j) {
+      letter[j] = (i * 7 + j) % 256;
+    }
+    data.Add(i + 1, letter.data());
+  }
+  s21::MatrixNetwork straight, stopped;
+  straight.LoadWeights(s21::kWeightsFileLoad);
+  stopped.LoadWeights(s21::kWeightsFileLoad);
+  std::vector<double> initial, weights;
+  straight.GetWeights(&initial);
+  s21::JobRunner jobs;
+  jobs.StartTraining(&straight, data, nullptr, 3);
+  jobs.Wait();
+
+  //  The run stops after one epoch, the checkpoint round trips to a graph
+  //  network and its run is extended to the three epochs
+  s21::CheckpointOptions checkpoints;
+  checkpoints.file = s21::kCheckpointFileTest;
+  checkpoints.every_batches = 1;
+  jobs.StartTraining(&stopped, data, nullptr, 1, checkpoints);
+  jobs.Wait();
+  s21::Checkpoint checkpoint = s21::LoadCheckpoint(s21::kCheckpointFileTest);
+  ASSERT_EQ(checkpoint.type, s21::kMatrixNet);
+  ASSERT_EQ(checkpoint.num_layers, 4);
+  ASSERT_EQ(checkpoint.epoch, 2);
+  ASSERT_EQ(checkpoint.cursor, 1);
+  ASSERT_EQ(checkpoint.test_accuracy, std::vector<double>({-1}));
+  ASSERT_EQ(checkpoint.curve.GetEpochs().size(), 1);
+  stopped.GetWeights(&weights);
+  ASSERT_EQ(checkpoint.weights, weights);
+  checkpoint.num_epochs = 3;
+  s21::GraphNetwork resumed;
+  jobs.ResumeTraining(&resumed, data, nullptr, checkpoint, checkpoints);
+  jobs.Wait();
+  ASSERT_EQ(jobs.GetEpochResults().size(), 3);
+  ASSERT_EQ(jobs.GetEpochResults()[0].time, 0);
+  resumed.GetWeights(&weights);
+  std::vector<double> expected;
+  straight.GetWeights(&expected);
+  ASSERT_EQ(weights.size(), expected.size());
+  for (size_t i = 0; i < weights.size(); ++i) {
+    ASSERT_NEAR(weights[i], expected[i], 1e-9);
+  }
+  ASSERT_EQ(s21::LoadCheckpoint(s21::kCheckpointFileTest).epoch, 4);
+
+  //  A cancelled run saves where it stopped, here before its first batch
+  std::promise<void> gate;
+  s21::GatedDataSet gated(data, gate.get_future().share());
+  stopped.LoadWeights(s21::kWeightsFileLoad);
+  jobs.StartTraining(&stopped, gated, nullptr, 2, checkpoints);
+  jobs.Cancel();
+  gate.set_value();
+  jobs.Wait();
+  checkpoint = s21::LoadCheckpoint(s21::kCheckpointFileTest);
+  ASSERT_EQ(checkpoint.epoch, 1);
+  ASSERT_EQ(checkpoint.cursor, 1);
+  ASSERT_EQ(checkpoint.weights, initial);
+
+  std::ofstream(s21::kCheckpointFileTest) << "MLPC";
+  ASSERT_THROW(s21::LoadCheckpoint(s21::kCheckpointFileTest),
+               std::invalid_argument);
+  std::remove(s21::kCheckpointFileTest.c_str());
+}
+
+TEST(SnapshotStore, Publish) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  s21::SnapshotStore store;
+  ASSERT_FALSE(store.Pin());
+  ASSERT_EQ(store.Publish(&mn), 1);
+  std::vector<uint8_t> images(3 * s21::kInputLayerNeurons);
+  for (size_t i = 0; i < images.size(); ++i) {
+    images[i] = i * 13 % 256;
+  }
+  std::vector<double> expected(3 * s21::kOutputLayerNeurons);
+  std::vector<double> outputs(expected.size());
+  mn.PredictBatch(images.data(), 3, expected.data());
+  s21::SnapshotPin first = store.Pin();
+  first->PredictBatch(images.data(), 3, outputs.data());
+  ASSERT_EQ(outputs, expected);
+
+  //  The pinned version outlives its replacement
+  size_t count = 1;
+  mn.TrainNetwork(*data, count, 0, 0);
+  ASSERT_EQ(store.Publish(&mn), 2);
+  ASSERT_EQ(store.GetNumRetired(), 1);
+  ASSERT_EQ(first->GetVersion(), 1);
+  first->PredictBatch(images.data(), 3, outputs.data());
+  ASSERT_EQ(outputs, expected);
+  ASSERT_EQ(store.Pin()->GetVersion(), 2);
+  { s21::SnapshotPin released = std::move(first); }
+  ASSERT_EQ(store.GetNumRetired(), 0);
+
+  //  Readers predict while a job trains and publishes
+  s21::JobRunner jobs;
+  jobs.SetSnapshots(&store);
+  std::atomic<bool> done(false);
+  std::thread reader([&] {
+    std::vector<double> live(s21::kOutputLayerNeurons);
+    uint64_t version = 0;
+    while (!done) {
+      s21::SnapshotPin snapshot = store.Pin();
+      ASSERT_GE(snapshot->GetVersion(), version);
+      version = snapshot->GetVersion();
+      snapshot->PredictBatch(images.data(), 1, live.data());
+    }
+  });
+  jobs.StartTraining(&mn, *data, nullptr, 3);
+  jobs.Wait();
+  done = true;
+  reader.join();
+  ASSERT_EQ(store.GetVersion(), 6);
+  ASSERT_EQ(store.GetNumRetired(), 0);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(ModelRegistry, Get) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  s21::ModelRegistry models;
+  ASSERT_GE(models.RegisterDirectory(s21::kWeightsDir), 3);
+  ASSERT_THROW(models.RegisterDirectory("./no-such-dir"),
+               std::invalid_argument);
+  models.Register("a", s21::kWeightsFileLoad);
+
+  //  Loaded once, the same weights as LoadWeights, by name or by file
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::vector<double> weights;
+  mn.GetWeights(&weights);
+  auto model = models.Get("a");
+  ASSERT_EQ(model->GetWeights(), weights);
+  ASSERT_EQ(models.Get(s21::kWeightsFileLoad), model);
+  std::vector<int> input_layer(data->GetImage(0),
+                               data->GetImage(0) + s21::kInputLayerNeurons);
+  ASSERT_EQ(model->Predict(input_layer), mn.Predict(input_layer));
+  size_t count = 1;
+  mn.TestNetwork(*data, count, data->GetSize());
+  s21::ConfusionCounts counts = model->Test(*data, data->GetSize());
+  ASSERT_EQ(counts.GetTotal(), data->GetSize());
+  for (int i = 0; i < s21::kNumClasses; ++i) {
+    for (int j = 0; j < s21::kNumClasses; ++j) {
+      ASSERT_EQ(counts.Get(i, j), mn.GetConfusionCounts().Get(i, j));
+    }
+  }
+  ASSERT_THROW(models.Get("weights_2l"), std::invalid_argument);
+  ASSERT_FALSE(models.IsLoaded("weights_2l"));
+
+  //  Concurrent loads, the LRU keeps what fits
+  models.Preload({"weights_2_784", "weights_2_784_85", "weights_5_784_1e",
+                  "weights_2_784_85", "weights_5_784_1e"});
+  s21::ModelCacheStats stats = models.GetStats();
+  ASSERT_EQ(stats.misses, 5);
+  ASSERT_EQ(stats.hits, 3);
+  ASSERT_EQ(stats.num_loaded, 4);
+  models.SetMaxBytes(stats.bytes / 2);
+  ASSERT_LE(models.GetStats().bytes, stats.bytes / 2);
+  ASSERT_FALSE(models.IsLoaded("a"));
+  ASSERT_EQ(model->Predict(input_layer), mn.Predict(input_layer));
+  models.SetMaxBytes(0);
+  ASSERT_EQ(models.GetStats().num_loaded, 1);
+  models.Get("a");
+  ASSERT_TRUE(models.IsLoaded("a"));
+  ASSERT_EQ(models.GetStats().num_loaded, 1);
+  models.Evict("a");
+  ASSERT_EQ(models.GetStats().num_loaded, 0);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(Ensemble, Combine) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  s21::ModelRegistry models;
+  models.RegisterDirectory(s21::kWeightsDir);
+  std::vector<std::shared_ptr<const s21::WeightSnapshot>> loaded = {
+      models.Get(s21::kWeightsFileLoad), models.Get("weights_2_784_85"),
+      models.Get("weights_5_784_1e")};
+  ASSERT_THROW(s21::Ensemble({}), std::invalid_argument);
+  size_t count = 20;
+  std::vector<uint8_t> images(count * s21::kInputLayerNeurons);
+  for (size_t i = 0; i < images.size(); ++i) {
+    images[i] = (i * 13 + i / s21::kInputLayerNeurons * 71) % 256;
+  }
+  std::vector<std::vector<double>> expected(loaded.size());
+  for (size_t m = 0; m < loaded.size(); ++m) {
+    expected[m].resize(count * s21::kOutputLayerNeurons);
+    loaded[m]->PredictBatch(images.data(), count, expected[m].data());
+  }
+  std::vector<double> outputs(count * s21::kOutputLayerNeurons);
+  s21::Ensemble single({loaded[0]});
+  single.PredictBatch(images.data(), count, outputs.data());
+  ASSERT_EQ(outputs, expected[0]);
+
+  //  The stacked batch and the parallel single-image paths agree
+  for (auto mode : {s21::kMeanProbability, s21::kMajorityVote}) {
+    s21::Ensemble ensemble(loaded, mode);
+    ensemble.PredictBatch(images.data(), count, outputs.data());
+    for (size_t i = 0; i < count; ++i) {
+      std::vector<double> mean(s21::kOutputLayerNeurons);
+      std::vector<int> votes(s21::kOutputLayerNeurons);
+      for (auto& it : expected) {
+        const double* output = it.data() + i * s21::kOutputLayerNeurons;
+        for (int j = 0; j < s21::kOutputLayerNeurons; ++j) {
+          mean[j] += output[j];
+        }
+        ++votes[std::max_element(output, output + s21::kOutputLayerNeurons) -
+                output];
+      }
+      for (int j = 0; j < s21::kOutputLayerNeurons; ++j) {
+        mean[j] /= loaded.size();
+        double value = mode == s21::kMeanProbability
+                           ? mean[j]
+                           : (votes[j] + mean[j]) / (loaded.size() + 1);
+        ASSERT_EQ(outputs[i * s21::kOutputLayerNeurons + j], value);
+      }
+      double* output = outputs.data() + i * s21::kOutputLayerNeurons;
+      std::vector<int> input_layer(
+          images.begin() + i * s21::kInputLayerNeurons,
+          images.begin() + (i + 1) * s21::kInputLayerNeurons);
+      ASSERT_EQ(ensemble.Predict(input_layer),
+                std::max_element(output, output + s21::kOutputLayerNeurons) -
+                    output);
+    }
+    s21::ConfusionCounts counts = ensemble.Test(*data, data->GetSize());
+    ASSERT_EQ(counts.GetTotal(), data->GetSize());
+    for (size_t i = 0; i < data->GetSize(); ++i) {
+      std::vector<int> input_layer(data->GetImage(i),
+                                   data->GetImage(i) + s21::kInputLayerNeurons);
+      int label = data->GetLabel(i) - 1;
+      ASSERT_GE(counts.Get(label, ensemble.Predict(input_layer)), 1);
+    }
+  }
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(Preprocess, Bmp) {
+  int width = 13, height = 5;
+  std::vector<uint8_t> ink(width * height), bw(ink.size());
+  for (size_t i = 0; i < ink.size(); ++i) {
+    ink[i] = i * 37 % 256;
+    bw[i] = ink[i] > 127 ? 255 : 0;
+  }
+  for (int bits : {24, 32}) {
+    for (bool top_down : {false, true}) {
+      std::vector<uint8_t> bmp =
+          s21::EncodeBmpTest(ink, width, height, bits, top_down);
+      s21::InkImage image = s21::DecodeBmp(bmp.data(), bmp.size());
+      ASSERT_EQ(image.width, width);
+      ASSERT_EQ(image.height, height);
+      ASSERT_EQ(image.ink, ink);
+    }
+  }
+  std::vector<uint8_t> bmp = s21::EncodeBmpTest(ink, width, height, 1, false);
+  ASSERT_EQ(s21::DecodeBmp(bmp.data(), bmp.size()).ink, bw);
+  ASSERT_THROW(s21::DecodeBmp(bmp.data(), bmp.size() - 1),
+               std::invalid_argument);
+  bmp[28] = 8;
+  ASSERT_THROW(s21::DecodeBmp(bmp.data(), bmp.size()), std::invalid_argument);
+  ASSERT_THROW(s21::LoadBmp("./no-such.bmp"), std::invalid_argument);
+
+  //  Area average: blocks of 2 x 3 pixels become one, uneven scales keep
+  //  a plain image plain
+  s21::InkImage image;
+  image.width = 2 * s21::kNumNeurons;
+  image.height = 3 * s21::kNumNeurons;
+  image.ink.resize(image.width * image.height);
+  for (int y = 0; y < image.height; ++y) {
+    for (int x = 0; x < image.width; ++x) {
+      image.ink[y * image.width + x] = (x / 2 * 9 + y / 3) % 200 + x % 2 * 2;
+    }
+  }
+  uint8_t pixels[s21::kInputLayerNeurons];
+  s21::DownscaleArea(image, s21::kNumNeurons, s21::kNumNeurons, pixels);
+  for (int y = 0; y < s21::kNumNeurons; ++y) {
+    for (int x = 0; x < s21::kNumNeurons; ++x) {
+      ASSERT_EQ(pixels[y * s21::kNumNeurons + x], (x * 9 + y) % 200 + 1);
+    }
+  }
+  image.width = 100;
+  image.height = 37;
+  image.ink.assign(image.width * image.height, 77);
+  s21::DownscaleArea(image, s21::kNumNeurons, s21::kNumNeurons, pixels);
+  ASSERT_EQ(std::count(pixels, pixels + s21::kInputLayerNeurons, 77),
+            s21::kInputLayerNeurons);
+
+  //  The input layer is stored column by column like EMNIST
+  image.width = image.height = s21::kNumNeurons;
+  image.ink.assign(s21::kInputLayerNeurons, 0);
+  image.ink[10 * s21::kNumNeurons + 3] = 255;
+  s21::PreprocessImage(image, pixels);
+  ASSERT_EQ(pixels[3 * s21::kNumNeurons + 10], 255);
+  ASSERT_EQ(std::count(pixels, pixels + s21::kInputLayerNeurons, 0),
+            s21::kInputLayerNeurons - 1);
+}
+
+TEST(ImageBatch, Classify) {
+  //  More images than one batch, a broken one and a file that isn't one
+  namespace fs = std::filesystem;
+  fs::remove_all(s21::kImageDirTest);
+  fs::create_directory(s21::kImageDirTest);
+  size_t num_images = s21::kImageBatch + 5;
+  for (size_t i = 0; i < num_images; ++i) {
+    std::vector<uint8_t> ink(30 * 20);
+    for (size_t j = 0; j < ink.size(); ++j) {
+      ink[j] = (j * (i + 3)) % 7 < 2 ? 255 : 0;
+    }
+    std::vector<uint8_t> bmp = s21::EncodeBmpTest(ink, 30, 20, 24, i % 2);
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%04zu%s", i, i == 7 ? ".BMP" : ".bmp");
+    if (i == 3) {
+      bmp.resize(60);
+    }
+    std::ofstream(s21::kImageDirTest + name, std::ios::binary)
+        .write(reinterpret_cast<const char*>(bmp.data()), bmp.size());
+  }
+  std::ofstream(s21::kImageDirTest + "/notes.txt") << "not an image";
+  std::vector<std::string> files = s21::ListImages(s21::kImageDirTest);
+  ASSERT_EQ(files.size(), num_images);
+  ASSERT_TRUE(std::is_sorted(files.begin(), files.end()));
+  ASSERT_THROW(s21::ListImages("./no-such-dir"), std::invalid_argument);
+
+  //  The letters of PredictImage, in order
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::vector<s21::ImageResult> results;
+  s21::ClassifyStats stats = s21::ClassifyImages(
+      files,
+      [&mn](const uint8_t* images, size_t count, double* outputs) {
+        ASSERT_LE(count, s21::kImageBatch);
+        mn.PredictBatch(images, count, outputs);
+      },
+      [&results](const s21::ImageResult& result) {
+        results.push_back(result);
+      });
+  ASSERT_EQ(stats.num_images, num_images);
+  ASSERT_EQ(stats.num_failed, 1);
+  ASSERT_EQ(results.size(), num_images);
+  uint8_t input[s21::kInputLayerNeurons];
+  for (size_t i = 0; i < num_images; ++i) {
+    ASSERT_EQ(results[i].file, files[i]);
+    if (i == 3) {
+      ASSERT_EQ(results[i].prediction, -1);
+      ASSERT_FALSE(results[i].error.empty());
+      continue;
+    }
+    s21::PreprocessImage(s21::LoadBmp(files[i]), input);
+    ASSERT_EQ(results[i].prediction,
+              mn.Predict(std::vector<int>(input,
+                                          input + s21::kInputLayerNeurons)));
+    ASSERT_GT(results[i].confidence, 0);
+    ASSERT_TRUE(results[i].error.empty());
+  }
+  fs::remove_all(s21::kImageDirTest);
+}
+
+TEST(LivePredictor, Newest) {
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::mutex mutex;
+  std::vector<s21::LivePrediction> results;
+  s21::LivePredictor live(
+      [&mn](const uint8_t* images, size_t count, double* outputs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        mn.PredictBatch(images, count, outputs);
+      },
+      [&](const s21::LivePrediction& result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(result);
+      });
+  std::vector<s21::InkImage> images(10);
+  for (size_t i = 0; i < images.size(); ++i) {
+    images[i].width = images[i].height = s21::kNumNeurons;
+    for (int j = 0; j < s21::kInputLayerNeurons; ++j) {
+      images[i].ink.push_back(j * (i + 2) % 255);
+    }
+  }
+
+  //  A burst while the first image is predicted: only the last one follows
+  uint64_t sequence = 0;
+  for (auto& it : images) {
+    sequence = live.Submit([&it] { return it; });
+  }
+  live.Flush();
+  ASSERT_LE(live.GetNumPredicted(), 2);
+  ASSERT_EQ(results.back().sequence, sequence);
+  uint8_t input[s21::kInputLayerNeurons];
+  s21::PreprocessImage(images.back(), input);
+  double outputs[s21::kOutputLayerNeurons];
+  mn.PredictBatch(input, 1, outputs);
+  const s21::LivePrediction& result = results.back();
+  ASSERT_EQ(result.letters[0],
+            std::max_element(outputs, outputs + s21::kOutputLayerNeurons) -
+                outputs);
+  for (int i = 0; i < s21::kTopLetters; ++i) {
+    ASSERT_EQ(result.outputs[i], outputs[result.letters[i]]);
+    ASSERT_TRUE(i == 0 || result.outputs[i] <= result.outputs[i - 1]);
+  }
+  ASSERT_GE(result.latency_us, result.predict_us);
+
+  //  Errors come as results, a cancelled image never does
+  live.Submit([] { return s21::InkImage(); });
+  live.Flush();
+  ASSERT_FALSE(results.back().error.empty());
+  size_t num_predicted = live.GetNumPredicted();
+  live.Submit([&images] { return images[0]; });
+  live.Cancel();
+  live.Flush();
+  ASSERT_LE(live.GetNumPredicted(), num_predicted + 1);
+}
+
+TEST(DataLoader, SmallPool) {
+  //  More readers than workers: the consumer runs the waiting readers
+  s21::WriteDataSetFileTest();
+  s21::ThreadPool pool(1);
+  s21::DataLoader loader(s21::kDataSetFileTest, 3, 1, 1, &pool);
+  std::vector<int> labels;
+  while (const s21::SampleBatch* batch = loader.Next()) {
+    labels.push_back(batch->GetLabel(0));
+  }
+  ASSERT_EQ(labels, std::vector<int>({23, 1, 23}));
+  std::remove(s21::kDataSetFileTest.c_str());
+}
+
+TEST(ThreadPool, ParallelFor) {
+  s21::ThreadPool pool(3);
+  ASSERT_EQ(pool.GetSize(), 3);
+  std::vector<int> values(1000);
+  pool.ParallelFor(0, values.size(), 7, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      values[i] += i;
+    }
+  });
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(values[i], i);
+  }
+
+  //  Nested groups on every worker don't deadlock
+  std::atomic<int> count(0);
+  s21::TaskGroup outer(&pool);
+  for (int i = 0; i < 8; ++i) {
+    outer.Run([&] {
+      s21::TaskGroup inner(&pool);
+      for (int j = 0; j < 8; ++j) {
+        inner.Run([&] { ++count; });
+      }
+      inner.Wait();
+    });
+  }
+  outer.Wait();
+  ASSERT_EQ(count, 64);
+
+  s21::TaskGroup failing(&pool);
+  failing.Run([] { throw std::out_of_range("Error: task"); });
+  failing.Run([&] { ++count; });
+  ASSERT_THROW(failing.Wait(), std::out_of_range);
+  ASSERT_EQ(count, 65);
+}
+
+TEST(DataLoader, TestNetwork) {
+  s21::WriteDataSetFileTest();
+  s21::GraphNetwork gn;
+  gn.LoadWeights(s21::kWeightsFileLoad);
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  size_t count = 1;
+  gn.TestNetwork(*data, count, s21::kNumDataSetTests);
+  size_t errors = gn.GetCountErrors();
+
+  gn.ResetStatistics();
+  s21::DataLoader loader(s21::kDataSetFileTest);
+  count = 1;
+  for (; gn.TestNetwork(loader, count, s21::kNumDataSetTests);) {
+  }
+  ASSERT_EQ(count - 1, 3);
+  ASSERT_EQ(gn.GetCountErrors(), errors);
+
+  std::ofstream(s21::kDataSetFileTest, std::ios::app) << "1,2,3" << std::endl;
+  s21::DataLoader loader_error(s21::kDataSetFileTest, 1, 2, 2);
+  ASSERT_NE(loader_error.Next(), nullptr);
+  ASSERT_THROW(loader_error.Next(), std::length_error);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(Server, Predict) {
+  s21::WriteDataSetFileTest();
+  auto data = s21::OpenDataSet(s21::kDataSetFileTest);
+  s21::MatrixNetwork mn;
+  mn.LoadWeights(s21::kWeightsFileLoad);
+  std::vector<int> labels;
+  for (size_t i = 0; i < data->GetSize(); ++i) {
+    labels.push_back(mn.Predict(std::vector<int>(
+        data->GetImage(i), data->GetImage(i) + s21::kInputLayerNeurons)));
+  }
+  s21::ServerOptions options;
+  options.socket_path = s21::kServerSocketTest;
+  options.max_batch = 4;
+  options.max_queue = 8;
+  s21::InferenceServer server(&mn, options);
+  server.Start();
+
+  const size_t num_clients = 4, num_requests = 10;
+  std::vector<size_t> errors(num_clients);
+  std::vector<std::thread> clients;
+  for (size_t c = 0; c < num_clients; ++c) {
+    clients.emplace_back([&, c] {
+      s21::InferenceClient client(s21::kServerSocketTest);
+      std::vector<s21::ServerPrediction> predictions;
+      for (size_t r = 0; r < num_requests; ++r) {
+        size_t i = (c + r) % data->GetSize();
+        if (client.Predict(data->GetImage(i), 1, &predictions) !=
+                s21::kServerOk ||
+            predictions.size() != 1 ||
+            static_cast<int>(predictions[0].label) != labels[i]) {
+          ++errors[c];
+        }
+      }
+    });
+  }
+  for (auto& it : clients) {
+    it.join();
+  }
+  ASSERT_EQ(errors, std::vector<size_t>(num_clients));
+
+  s21::InferenceClient client(s21::kServerSocketTest);
+  std::vector<uint8_t> images(9 * s21::kInputLayerNeurons);
+  std::vector<s21::ServerPrediction> predictions;
+  //  More images than max_queue could never be admitted, even idle
+  ASSERT_EQ(client.Predict(images.data(), 9, &predictions),
+            s21::kServerBadRequest);
+  ASSERT_TRUE(predictions.empty());
+  ASSERT_NE(client.GetStats().find("\"bad_requests\": 1"), std::string::npos);
+  ASSERT_EQ(client.Predict(images.data(), 4, &predictions), s21::kServerOk);
+
+  s21::ServerStats stats = server.GetStats();
+  ASSERT_EQ(stats.requests, num_clients * num_requests + 1);
+  ASSERT_EQ(stats.images, num_clients * num_requests + 4);
+  ASSERT_EQ(stats.rejected, 0);
+  ASSERT_EQ(stats.queue_depth, 0);
+  ASSERT_LE(stats.max_queue_depth, options.max_queue);
+  ASSERT_LE(stats.mean_batch, options.max_batch);
+  ASSERT_GE(stats.max_latency_us, stats.mean_latency_us);
+
+  //  BMP files are preprocessed by the server, a broken one is refused
+  //  without losing the connection
+  std::vector<uint8_t> ink(40 * 40);
+  for (size_t i = 0; i < ink.size(); ++i) {
+    ink[i] = i % 40 > 15 && i % 40 < 25 ? 255 : 0;
+  }
+  std::vector<uint8_t> bmp = s21::EncodeBmpTest(ink, 40, 40, 24, false);
+  uint8_t input[s21::kInputLayerNeurons];
+  s21::PreprocessImage(s21::DecodeBmp(bmp.data(), bmp.size()), input);
+  ASSERT_EQ(client.PredictBmp(bmp.data(), bmp.size(), &predictions),
+            s21::kServerOk);
+  ASSERT_EQ(static_cast<int>(predictions[0].label),
+            mn.Predict(std::vector<int>(input,
+                                        input + s21::kInputLayerNeurons)));
+  bmp[0] = 'X';
+  ASSERT_EQ(client.PredictBmp(bmp.data(), bmp.size(), &predictions),
+            s21::kServerBadRequest);
+  ASSERT_EQ(client.Predict(images.data(), 1, &predictions), s21::kServerOk);
+  server.Stop();
+  ASSERT_THROW(s21::InferenceClient(s21::kServerSocketTest),
+               std::invalid_argument);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(Decompressor, Gzip) {
+  s21::WriteDataSetFileGzTest();
+  std::ifstream plain(s21::kDataSetFileTest);
+  s21::DecompressStream fp(s21::kDataSetFileGz);
+  std::string expected, line;
+  size_t lines = 0;
+  for (; std::getline(plain, expected); ++lines) {
+    ASSERT_TRUE(std::getline(fp, line));
+    ASSERT_EQ(line, expected);
+  }
+  ASSERT_EQ(lines, 3);
+  ASSERT_FALSE(std::getline(fp, line));
+
+  auto data = s21::OpenDataSet(s21::kDataSetFileGz);
+  ASSERT_EQ(data->GetSize(), 3);
+  ASSERT_EQ(data->GetLabel(0), 23);
+  ASSERT_EQ(data->GetImage(1)[300], 300 % 256);
+
+  s21::DataLoader loader(s21::kDataSetFileGz, 4, 1, 1);
+  std::vector<int> labels;
+  while (const s21::SampleBatch* batch = loader.Next()) {
+    labels.push_back(batch->GetLabel(0));
+  }
+  ASSERT_EQ(labels, std::vector<int>({23, 1, 23}));
+
+  std::ofstream(s21::kDataSetFileGz) << "not gzip";
+  s21::DecompressStream raw(s21::kDataSetFileGz);
+  ASSERT_TRUE(std::getline(raw, line));
+  ASSERT_EQ(line, "not gzip");
+  ASSERT_EQ(s21::StripCompressionExtension(s21::kDataSetFileGz),
+            s21::kDataSetFileTest);
+  ASSERT_THROW(s21::DecompressStream("./datasets/absent.csv.gz"),
+               std::invalid_argument);
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileGz.c_str());
+  std::remove(s21::kDataSetFileBin.c_str());
+}
+
+TEST(Decompressor, TruncatedGzip) {
+  //  Cut in half, or only the trailer lost: an error, never a short file
+  s21::WriteDataSetFileGzTest();
+  std::ifstream fp(s21::kDataSetFileGz, std::ios::binary);
+  std::string gz((std::istreambuf_iterator<char>(fp)),
+                 std::istreambuf_iterator<char>());
+  for (size_t size : {gz.size() / 2, gz.size() - 4}) {
+    std::ofstream(s21::kDataSetFileGz, std::ios::binary)
+        .write(gz.data(), size);
+    s21::DecompressStream cut(s21::kDataSetFileGz);
+    std::string line;
+    ASSERT_ANY_THROW(while (std::getline(cut, line)){});
+    std::remove(s21::kDataSetFileBin.c_str());
+    ASSERT_ANY_THROW(s21::OpenDataSet(s21::kDataSetFileGz));
+    ASSERT_FALSE(std::ifstream(s21::kDataSetFileBin).is_open());
+  }
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileGz.c_str());
+}
+
+#ifdef MLP_WITH_ZSTD
+TEST(Decompressor, Zstd) {
+  s21::WriteDataSetFileTest();
+  std::ifstream plain(s21::kDataSetFileTest, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(plain)),
+                   std::istreambuf_iterator<char>());
+  std::string zst(ZSTD_compressBound(data.size()), '\0');
+  zst.resize(ZSTD_compress(zst.data(), zst.size(), data.data(), data.size(),
+                           ZSTD_CLEVEL_DEFAULT));
+  std::ofstream(s21::kDataSetFileZst, std::ios::binary)
+      .write(zst.data(), zst.size());
+  s21::DecompressStream fp(s21::kDataSetFileZst);
+  std::string unpacked((std::istreambuf_iterator<char>(fp)),
+                       std::istreambuf_iterator<char>());
+  ASSERT_EQ(unpacked, data);
+  auto dataset = s21::OpenDataSet(s21::kDataSetFileZst);
+  ASSERT_EQ(dataset->GetSize(), 3);
+  ASSERT_EQ(dataset->GetImage(1)[300], 300 % 256);
+  std::remove(s21::kDataSetFileBin.c_str());
+
+  //  A frame cut short is an error like a truncated gzip stream
+  std::ofstream(s21::kDataSetFileZst, std::ios::binary)
+      .write(zst.data(), zst.size() / 2);
+  s21::DecompressStream cut(s21::kDataSetFileZst);
+  std::string line;
+  ASSERT_ANY_THROW(while (std::getline(cut, line)){});
+  ASSERT_ANY_THROW(s21::OpenDataSet(s21::kDataSetFileZst));
+  ASSERT_FALSE(std::ifstream(s21::kDataSetFileBin).is_open());
+  std::remove(s21::kDataSetFileTest.c_str());
+  std::remove(s21::kDataSetFileZst.c_str());
+}
+#else
+TEST(Decompressor, Zstd) {
+  std::ofstream(s21::kDataSetFileZst) << "zstd";
+  ASSERT_THROW(s21::DecompressStream fp(s21::kDataSetFileZst),
+               std::invalid_argument);
+  std::remove(s21::kDataSetFileZst.c_str());
 }
+#endif
 
 TEST(MatrixNetwork, Init) {
   s21::MatrixNetwork mn;
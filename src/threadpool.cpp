@@ -0,0 +1,210 @@
+#include "threadpool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include <algorithm>
+#include <chrono>  // NOLINT(*)
+#include <string>
+
+#include "tracer.h"
+
+namespace s21 {
+
+static std::atomic<ThreadPool*> default_pool(nullptr);
+
+//  The pool and the index of the worker running on this thread
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+ThreadPool::ThreadPool(size_t num_threads, bool pin_threads)
+    : pin_threads_(pin_threads), pending_(0), next_worker_(0), stop_(false) {
+  size_t num_cores = std::max(1u, std::thread::hardware_concurrency());
+  if (num_threads == 0) {
+    num_threads = num_cores;
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_[i]->thread = std::thread(&ThreadPool::Work_, this, i);
+#ifdef __linux__
+    if (pin_threads_) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i % num_cores, &cpus);
+      pthread_setaffinity_np(workers_[i]->thread.native_handle(),
+                             sizeof(cpus), &cpus);
+    }
+#endif
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& it : workers_) {
+    it->thread.join();
+  }
+  ThreadPool* self = this;
+  default_pool.compare_exchange_strong(self, nullptr);
+}
+
+ThreadPool* ThreadPool::GetDefault() {
+  ThreadPool* pool = default_pool.load(std::memory_order_acquire);
+  if (pool) {
+    return pool;
+  }
+  static ThreadPool fallback;
+  return &fallback;
+}
+
+void ThreadPool::SetDefault(ThreadPool* pool) {
+  default_pool.store(pool, std::memory_order_release);
+}
+
+size_t ThreadPool::GetWorkerIndex_() {
+  return current_pool == this
+             ? current_worker
+             : next_worker_.fetch_add(1, std::memory_order_relaxed) %
+                   workers_.size();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  Worker& worker = *workers_[GetWorkerIndex_()];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  {
+    //  Taken so that a worker about to sleep can't miss the task
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    pending_.fetch_add(1, std::memory_order_release);
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::Pop_(size_t first, std::function<void()>* task) {
+  if (pending_.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker& worker = *workers_[(first + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      continue;
+    }
+    //  The own deque is used as a stack, the others are robbed from the
+    //  other end
+    if (i == 0 && current_pool == this) {
+      *task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+    } else {
+      *task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+    }
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+bool ThreadPool::RunPending() {
+  std::function<void()> task;
+  if (!Pop_(GetWorkerIndex_(), &task)) {
+    return false;
+  }
+  task();
+  return true;
+}
+
+void ThreadPool::Work_(size_t index) {
+  current_pool = this;
+  current_worker = index;
+  Tracer::GetInstance().SetThreadName("worker " + std::to_string(index));
+  std::function<void()> task;
+  for (;;) {
+    if (Pop_(index, &task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this] {
+      return stop_ || pending_.load(std::memory_order_acquire) > 0;
+    });
+    if (stop_) {
+      break;
+    }
+  }
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)>& body) {
+  grain = std::max<size_t>(grain, 1);
+  if (end <= begin + grain) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+  TaskGroup group(this);
+  size_t first = begin;
+  for (; first + grain < end; first += grain) {
+    group.Run([&body, first, grain] { body(first, first + grain); });
+  }
+  body(first, end);
+  group.Wait();
+}
+
+TaskGroup::~TaskGroup() { WaitAll_(); }
+
+void TaskGroup::Run(std::function<void()> task) {
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  pool_->Submit([this, task = std::move(task)] {
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      done_.notify_all();
+    }
+  });
+}
+
+void TaskGroup::WaitAll_() {
+  while (pending_.load(std::memory_order_acquire) > 0) {
+    if (pool_->RunPending()) {
+      continue;
+    }
+    //  The remaining tasks run elsewhere; wakes up now and then to help
+    //  with the tasks they submit
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait_for(lock, std::chrono::milliseconds(1), [this] {
+      return pending_.load(std::memory_order_acquire) == 0;
+    });
+  }
+  //  The last task may still hold the mutex after its decrement
+  std::lock_guard<std::mutex> lock(mutex_);
+}
+
+void TaskGroup::Wait() {
+  WaitAll_();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace s21
@@ -0,0 +1,92 @@
+#ifndef SRC_THREADPOOL_H_
+#define SRC_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace s21 {
+
+//  Work-stealing pool for the parallel work of the core library. Every
+//  worker has its own deque: it runs its newest task first and, when empty,
+//  steals the oldest task of another worker. Tasks submitted by a worker
+//  stay on its deque, the others are spread round-robin. Threads waiting
+//  for a TaskGroup run queued tasks meanwhile, so nested groups can't
+//  deadlock
+class ThreadPool {
+ public:
+  //  0 threads means one per hardware core; pinned workers are bound to
+  //  cores round-robin (Linux only, ignored elsewhere)
+  explicit ThreadPool(size_t num_threads = 0, bool pin_threads = false);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  size_t GetSize() const { return workers_.size(); }
+  bool IsPinned() const { return pin_threads_; }
+
+  void Submit(std::function<void()> task);
+  //  Runs one queued task on the calling thread, false if there was none
+  bool RunPending();
+
+  //  Calls body(first, last) on chunks of at most grain indices of
+  //  [begin, end) in parallel and returns when all are done
+  void ParallelFor(size_t begin, size_t end, size_t grain,
+                   const std::function<void(size_t, size_t)>& body);
+
+  //  The pool used when none is given, the Controller installs its own
+  static ThreadPool* GetDefault();
+  static void SetDefault(ThreadPool* pool);
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  bool pin_threads_;
+  std::atomic<size_t> pending_;
+  std::atomic<size_t> next_worker_;
+  std::atomic<bool> stop_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+
+  bool Pop_(size_t first, std::function<void()>* task);
+  void Work_(size_t index);
+  size_t GetWorkerIndex_();
+};
+
+//  Tasks that are waited for together. Wait rethrows the first exception of
+//  a task; the destructor waits without rethrowing
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool* pool = ThreadPool::GetDefault())
+      : pool_(pool), pending_(0) {}
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+  ~TaskGroup();
+
+  void Run(std::function<void()> task);
+  void Wait();
+
+ private:
+  ThreadPool* pool_;
+  std::atomic<size_t> pending_;
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::exception_ptr error_;
+
+  void WaitAll_();
+};
+
+}  // namespace s21
+
+#endif  //  SRC_THREADPOOL_H_
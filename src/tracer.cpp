@@ -0,0 +1,116 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT(*)
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace s21 {
+
+uint64_t Tracer::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Tracer::Start(size_t events_per_thread) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffers_.clear();
+  capacity_ = std::max<size_t>(events_per_thread, 1);
+  origin_ = Now();
+  generation_.fetch_add(1, std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+//  Kept for the buffers of later Starts of long-lived threads
+static thread_local std::string thread_name;
+
+Tracer::Buffer* Tracer::GetBuffer_() {
+  static thread_local Buffer* buffer = nullptr;
+  static thread_local uint32_t generation = 0;
+  uint32_t current = generation_.load(std::memory_order_relaxed);
+  if (!buffer || generation != current) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto created = std::make_unique<Buffer>();
+    created->events.resize(std::min(capacity_, kTraceEventsInitial));
+    created->head.store(0, std::memory_order_relaxed);
+    created->tid = static_cast<int>(buffers_.size()) + 1;
+    created->name = thread_name.empty()
+                        ? "thread " + std::to_string(created->tid)
+                        : thread_name;
+    buffer = created.get();
+    generation = current;
+    buffers_.push_back(std::move(created));
+  }
+  return buffer;
+}
+
+void Tracer::Record(const char* name, uint64_t begin, uint64_t end) {
+  Buffer* buffer = GetBuffer_();
+  uint64_t head = buffer->head.load(std::memory_order_relaxed);
+  if (head == buffer->events.size() && head < capacity_) {
+    Grow_(buffer);
+  }
+  buffer->events[head % buffer->events.size()] = TraceEvent{name, begin, end};
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+//  Only before the ring wraps, so the spans keep their places
+void Tracer::Grow_(Buffer* buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer->events.resize(std::min(capacity_, buffer->events.size() * 2));
+}
+
+void Tracer::SetThreadName(const std::string& name) {
+  thread_name = name;
+  if (IsEnabled()) {
+    Buffer* buffer = GetBuffer_();
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer->name = name;
+  }
+}
+
+static std::string QuoteTraceName(const std::string& name) {
+  std::string result = "\"";
+  for (char c : name) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result + "\"";
+}
+
+void Tracer::Dump(const std::string& file_name) {
+  std::ofstream fp(file_name);
+  if (!fp.is_open()) {
+    throw std::invalid_argument("Error: can't save the " + file_name);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  fp << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  bool first = true;
+  char line[64];
+  for (auto& buffer : buffers_) {
+    fp << (first ? "\n" : ",\n")
+       << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+       << buffer->tid << ", \"args\": {\"name\": "
+       << QuoteTraceName(buffer->name) << "}}";
+    first = false;
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t size = buffer->events.size();
+    for (uint64_t i = head > size ? head - size : 0; i < head; ++i) {
+      const TraceEvent& event = buffer->events[i % size];
+      //  Chrome trace times are microseconds
+      std::snprintf(line, sizeof(line), "%.3f, \"dur\": %.3f",
+                    (event.begin - origin_) * 1e-3,
+                    (event.end - event.begin) * 1e-3);
+      fp << ",\n{\"name\": " << QuoteTraceName(event.name)
+         << ", \"cat\": \"mlp\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+         << buffer->tid << ", \"ts\": " << line << "}";
+    }
+  }
+  fp << "\n]}" << std::endl;
+}
+
+}  // namespace s21
@@ -0,0 +1,95 @@
+#ifndef SRC_TRACER_H_
+#define SRC_TRACER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace s21 {
+
+//  Most spans kept per thread; a ring starts small and doubles up to it
+const size_t kTraceEventsPerThread = 1 << 20;
+const size_t kTraceEventsInitial = 1 << 10;
+
+struct TraceEvent {
+  const char* name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+//  Timeline of spans for chrome://tracing or Perfetto. Off until Start;
+//  each thread records into its own ring without locks. A ring grows with
+//  the spans of its thread, so threads that record little cost little;
+//  once at events_per_thread the oldest spans are overwritten. Start and
+//  Dump are meant to be called while no traced work is running
+class Tracer {
+ public:
+  static Tracer& GetInstance() {
+    static Tracer tracer;
+    return tracer;
+  }
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  void Start(size_t events_per_thread = kTraceEventsPerThread);
+  void Stop() { enabled_.store(false, std::memory_order_relaxed); }
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  //  Span names must be string literals (only the pointer is kept)
+  void Record(const char* name, uint64_t begin, uint64_t end);
+  void SetThreadName(const std::string& name);
+
+  //  Writes the recorded spans as Chrome trace JSON
+  void Dump(const std::string& file_name);
+
+  //  Nanoseconds of the steady clock
+  static uint64_t Now();
+
+ private:
+  struct Buffer {
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head;
+    int tid;
+    std::string name;
+  };
+
+  std::atomic<bool> enabled_;
+  std::atomic<uint32_t> generation_;
+  size_t capacity_;
+  uint64_t origin_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+
+  Tracer() : enabled_(false), generation_(0), capacity_(0), origin_(0) {}
+  Buffer* GetBuffer_();
+  void Grow_(Buffer* buffer);
+};
+
+//  Records the time until the end of scope when tracing is on
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name)
+      : name_(Tracer::GetInstance().IsEnabled() ? name : nullptr),
+        begin_(name_ ? Tracer::Now() : 0) {}
+  ~TraceSpan() {
+    if (name_) {
+      Tracer::GetInstance().Record(name_, begin_, Tracer::Now());
+    }
+  }
+
+ private:
+  const char* name_;
+  uint64_t begin_;
+};
+
+}  // namespace s21
+
+#define MLP_TRACE_CONCAT_(a, b) a##b
+#define MLP_TRACE_NAME_(a, b) MLP_TRACE_CONCAT_(a, b)
+#define MLP_TRACE_SPAN(name) \
+  s21::TraceSpan MLP_TRACE_NAME_(mlp_trace_span_, __LINE__)(name)
+
+#endif  //  SRC_TRACER_H_